@@ -0,0 +1,470 @@
+// bench.cpp: repeatable performance harness; regenerates benchmarks.md.
+//
+//   bench [--repeat N] [--warmup N] [--md FILE] [--json FILE]
+//         [--baseline FILE.json] [--threshold PCT]
+//
+// Every case is run 'warmup' times untimed, then 'repeat' times timed; the
+// median and p95 wall times are reported, with throughput at the median.
+// With --baseline, a case whose time per unit (ns per node or evaluation)
+// is more than PCT percent above the stored one is flagged and the exit
+// code is 3. A case whose work changed (a search that now visits another
+// number of nodes) is reported as such: its speed is compared per unit,
+// but the change itself is a behaviour change, not a speed-up.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define CHESS_NO_MAIN
+#include "minimax.cpp"
+
+// Stamped in by the build, e.g.
+//   -DBENCH_COMMIT="\"$(git rev-parse --short HEAD)\"" -DBENCH_FLAGS="\"-O3 -march=native\""
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT "unknown"
+#endif
+#ifndef BENCH_FLAGS
+#define BENCH_FLAGS "unknown"
+#endif
+
+static const char* KIWIPETE = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+static const char* POS3     = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1";
+static const char* POS4     = "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1";
+static const char* MIDGAME  = "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10";
+
+static Game from_fen(const char* fen) {
+    Game g;
+    std::string err;
+    if (!g.load_fen(fen, err)) { std::cerr << "bad bench FEN: " << err << "\n"; std::exit(1); }
+    return g;
+}
+
+// One benchmark: 'run' does the work once and returns how many units
+// (nodes, evaluations) it processed.
+struct BenchCase {
+    std::string name;
+    std::string unit;
+    std::function<uint64_t()> run;
+    int threads = 0;          // > 0: one step of the Lazy SMP scaling series
+};
+
+struct BenchResult {
+    std::string name, unit;
+    int threads = 0;
+    uint64_t work = 0;        // units per run
+    double median_ms = 0, p95_ms = 0, min_ms = 0;
+    double rate() const { return median_ms > 0 ? work / (median_ms / 1000.0) : 0.0; }
+    double ns_per_unit() const { return work ? median_ms * 1e6 / work : 0.0; }
+};
+
+// No trained network ships with the engine; a random one of the real shape
+// costs exactly the same to run.
+static const nnue::Network* bench_network() {
+    static const std::unique_ptr<nnue::Network> net = [] {
+        auto n = std::make_unique<nnue::Network>();
+        n->randomize(2024);
+        return n;
+    }();
+    return net.get();
+}
+
+static std::vector<BenchCase> make_cases() {
+    std::vector<BenchCase> cases;
+    auto add_perft = [&](std::string name, const char* fen, int depth) {
+        cases.push_back({name + " perft d" + std::to_string(depth), "nodes", [fen, depth] {
+            Game g = from_fen(fen);
+            return perft(g, depth);
+        }});
+    };
+    add_perft("startpos", Game::STARTPOS_FEN, 5);
+    add_perft("kiwipete", KIWIPETE, 4);
+    add_perft("pos3", POS3, 5);
+    add_perft("pos4", POS4, 4);
+
+    // Fixed depth on a cleared table, so the node count is the same on every run.
+    auto add_search = [&](std::string name, const char* fen, int depth) {
+        cases.push_back({name + " search d" + std::to_string(depth), "nodes", [fen, depth] {
+            static MinimaxStrategy s;
+            s.tt.clear();
+            s.limits = SearchLimits{};
+            s.limits.depth = depth;
+            s.select_move(from_fen(fen));
+            return s.nodes;
+        }});
+    };
+    // Deep enough (1e5+ nodes) that clearing the table doesn't set ns/node.
+    add_search("startpos", Game::STARTPOS_FEN, 10);
+    add_search("kiwipete", KIWIPETE, 8);
+    add_search("midgame", MIDGAME, 10);
+    cases.push_back({"startpos search d7 nnue", "nodes", [] {
+        static MinimaxStrategy s;
+        s.tt.clear();
+        s.limits = SearchLimits{};
+        s.limits.depth = 7;
+        s.network = bench_network();
+        s.select_move(from_fen(Game::STARTPOS_FEN));
+        return s.nodes;
+    }});
+
+    // Lazy SMP time to depth: the same search on 1, 2, 4 and 8 threads.
+    // Helper threads change the node count, so the wall time is what counts.
+    for (int threads : {1, 2, 4, 8}) {
+        cases.push_back({"kiwipete search d9 threads " + std::to_string(threads), "nodes", [threads] {
+            static MinimaxStrategy s;
+            s.tt.clear();
+            s.limits = SearchLimits{};
+            s.limits.depth = 9;
+            s.threads = threads;
+            s.select_move(from_fen(KIWIPETE));
+            return s.nodes;
+        }, threads});
+    }
+
+    cases.push_back({"evaluate x20000", "evals", [] {
+        static const std::vector<Game> positions = {
+            from_fen(Game::STARTPOS_FEN), from_fen(KIWIPETE), from_fen(POS3),
+            from_fen(POS4), from_fen(MIDGAME)
+        };
+        volatile int sink = 0;
+        uint64_t n = 0;
+        for (int i = 0; i < 4000; ++i)
+            for (const Game& g : positions) { sink = sink + evaluate(g); ++n; }
+        return n;
+    }});
+
+    // The same positions packed and scored in one call, on one thread.
+    cases.push_back({"evaluate_batch x20000", "evals", [] {
+        static const std::vector<PackedPosition> batch = [] {
+            std::vector<PackedPosition> v;
+            for (const char* f : {Game::STARTPOS_FEN, KIWIPETE, POS3, POS4, MIDGAME}) {
+                PackedPosition p;
+                p.pack(from_fen(f));
+                v.push_back(p);
+            }
+            std::vector<PackedPosition> all;
+            for (int i = 0; i < 4000; ++i) all.insert(all.end(), v.begin(), v.end());
+            return all;
+        }();
+        static std::vector<int> scores(batch.size());
+        evaluate_batch(batch.data(), scores.data(), batch.size(), nullptr, 1);
+        return uint64_t(batch.size());
+    }});
+
+    // The same positions through the network, once per kernel set this CPU
+    // runs; the accumulators are built beforehand, as make_move would.
+    for (const nnue::Kernels* k : nnue::supported_kernels()) {
+        cases.push_back({std::string("nnue evaluate x20000 (") + k->name + ")", "evals", [k] {
+            static const std::vector<Game> positions = [] {
+                std::vector<Game> v = {
+                    from_fen(Game::STARTPOS_FEN), from_fen(KIWIPETE), from_fen(POS3),
+                    from_fen(POS4), from_fen(MIDGAME)
+                };
+                for (Game& g : v) g.set_network(bench_network());
+                return v;
+            }();
+            const nnue::Kernels* in_use = nnue::kernels;
+            nnue::kernels = k;
+            volatile int sink = 0;
+            uint64_t n = 0;
+            for (int i = 0; i < 4000; ++i)
+                for (const Game& g : positions) { sink = sink + nnue_evaluate(g); ++n; }
+            nnue::kernels = in_use;
+            return n;
+        }});
+    }
+    return cases;
+}
+
+static double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    size_t rank = (size_t)std::ceil(p / 100.0 * v.size()); // nearest-rank
+    return v[std::clamp<size_t>(rank, 1, v.size()) - 1];
+}
+
+static BenchResult measure(const BenchCase& c, int warmup, int repeat) {
+    using namespace std::chrono;
+    BenchResult r{c.name, c.unit, c.threads};
+    for (int i = 0; i < warmup; ++i) r.work = c.run();
+    std::vector<double> ms;
+    for (int i = 0; i < repeat; ++i) {
+        auto t0 = steady_clock::now();
+        r.work = c.run();
+        ms.push_back(duration<double, std::milli>(steady_clock::now() - t0).count());
+    }
+    r.median_ms = percentile(ms, 50);
+    r.p95_ms = percentile(ms, 95);
+    r.min_ms = *std::min_element(ms.begin(), ms.end());
+    return r;
+}
+
+// ----- environment stamp -----
+static std::string cpu_model() {
+#if defined(__linux__)
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line))
+        if (line.rfind("model name", 0) == 0 && line.find(':') != std::string::npos)
+            return line.substr(line.find(':') + 2);
+#elif defined(__APPLE__)
+    if (FILE* p = popen("sysctl -n machdep.cpu.brand_string", "r")) {
+        char buf[256] = {};
+        bool ok = std::fgets(buf, sizeof buf, p) != nullptr;
+        pclose(p);
+        std::string s = ok ? buf : "";
+        while (!s.empty() && (s.back() == '\n' || s.back() == '\r')) s.pop_back();
+        if (!s.empty()) return s;
+    }
+#endif
+    return "unknown";
+}
+
+static std::string compiler() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "g++ " __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+static std::string today() {
+    char buf[16];
+    std::time_t t = std::time(nullptr);
+    std::strftime(buf, sizeof buf, "%Y-%m-%d", std::localtime(&t));
+    return buf;
+}
+
+static std::string json_escape(const std::string& s) {
+    std::string o;
+    for (char c : s) {
+        if (c == '"' || c == '\\') o += '\\';
+        o += c;
+    }
+    return o;
+}
+
+// ----- baseline -----
+struct BaselineEntry {
+    uint64_t work = 0;
+    double ns_per_unit = 0;
+};
+
+// Reads back what to_json produced, one entry per case name. Records
+// written before ns_per_unit was stored get it from median_ms and work.
+static std::map<std::string, BaselineEntry> read_baseline(const std::string& path) {
+    std::map<std::string, BaselineEntry> base;
+    std::ifstream in(path);
+    if (!in) { std::cerr << "cannot open baseline " << path << "\n"; std::exit(1); }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string text = ss.str();
+    size_t pos = text.find("\"results\"");
+    while ((pos = text.find("\"name\":", pos)) != std::string::npos) {
+        size_t q0 = text.find('"', pos + 7), q1 = text.find('"', q0 + 1);
+        std::string name = text.substr(q0 + 1, q1 - q0 - 1);
+        std::string obj = text.substr(q1, text.find('}', q1) - q1);
+        auto field = [&](const std::string& key) {
+            size_t f = obj.find("\"" + key + "\":");
+            return f == std::string::npos ? -1.0 : std::strtod(obj.c_str() + f + key.size() + 3, nullptr);
+        };
+        BaselineEntry e;
+        double work = field("work"), ns = field("ns_per_unit"), ms = field("median_ms");
+        e.work = work > 0 ? uint64_t(work) : 0;
+        e.ns_per_unit = ns > 0 ? ns : (ms > 0 && work > 0 ? ms * 1e6 / work : 0);
+        base[name] = e;
+        pos = q1;
+    }
+    return base;
+}
+
+struct Comparison {
+    bool have = false;
+    double base_ns = 0, delta_pct = 0;   // ns/unit against the baseline
+    bool regressed = false;
+    bool work_changed = false;
+    uint64_t base_work = 0;
+};
+
+static std::string fmt(const char* f, double v) {
+    char buf[64];
+    std::snprintf(buf, sizeof buf, f, v);
+    return buf;
+}
+
+static std::string markdown(const std::vector<BenchResult>& rs, const std::vector<Comparison>& cmp,
+                            int warmup, int repeat, double threshold) {
+    std::ostringstream md;
+    md << "# Chess Engine Benchmarks (" << today() << ")\n\n"
+       << "Generated by `bench`; do not edit by hand.\n\n"
+       << "## Environment ##\n"
+       << "Commit: " << BENCH_COMMIT << "\n"
+       << "Compiler: " << compiler() << ", flags: " << BENCH_FLAGS << "\n"
+       << "CPU: " << cpu_model() << "\n"
+       << "Threads: 1 (scaling cases: as named), hardware threads: " << std::thread::hardware_concurrency()
+       << ", runs: " << warmup << " warmup + " << repeat << " timed\n\n"
+       << "## Results ##\n"
+       << "| case | work | median ms | p95 ms | rate | ns/unit |" << (cmp.empty() ? "" : " vs baseline |") << "\n"
+       << "|---|---:|---:|---:|---:|---:|" << (cmp.empty() ? "" : "---:|") << "\n";
+    for (size_t i = 0; i < rs.size(); ++i) {
+        const BenchResult& r = rs[i];
+        md << "| " << r.name << " | " << r.work << " " << r.unit
+           << " | " << fmt("%.3f", r.median_ms) << " | " << fmt("%.3f", r.p95_ms)
+           << " | " << fmt("%.0f", r.rate()) << " " << r.unit << "/s | " << fmt("%.1f", r.ns_per_unit()) << " |";
+        if (!cmp.empty()) {
+            if (!cmp[i].have) md << " new |";
+            else {
+                md << " " << fmt("%+.1f%%", cmp[i].delta_pct) << (cmp[i].regressed ? " **REGRESSION**" : "");
+                if (cmp[i].work_changed) md << " (work was " << cmp[i].base_work << ")";
+                md << " |";
+            }
+        }
+        md << "\n";
+    }
+    if (!cmp.empty())
+        md << "\nBaseline column: change in ns/unit; regression threshold " << fmt("%.1f", threshold)
+           << "%. \"work was\" marks a case whose work changed, i.e. a change in behaviour.\n";
+
+    // Speed-up of each scaling step over its single-thread run, only for
+    // steps the machine has a hardware thread per search thread for: beyond
+    // that the threads share cores, and the time says nothing about scaling.
+    double one_thread_ms = 0;
+    for (const BenchResult& r : rs)
+        if (r.threads == 1) one_thread_ms = r.median_ms;
+    if (one_thread_ms > 0) {
+        unsigned hw = std::thread::hardware_concurrency();
+        md << "\n## Lazy SMP scaling ##\n"
+           << "| threads | median ms | speed-up | nodes |\n"
+           << "|---:|---:|---:|---:|\n";
+        bool shared = false;
+        for (const BenchResult& r : rs)
+            if (r.threads > 0) {
+                bool fits = hw == 0 || unsigned(r.threads) <= hw;
+                shared |= !fits;
+                md << "| " << r.threads << " | " << fmt("%.3f", r.median_ms) << " | "
+                   << (fits ? fmt("%.2fx", one_thread_ms / r.median_ms) : "-") << " | " << r.work << " |\n";
+            }
+        if (shared)
+            md << "\nOnly " << hw << " hardware thread(s): rows marked - ran more search threads than that on "
+               << "shared cores, so they measure oversubscription, not Lazy SMP scaling.\n";
+    }
+
+    // ns per evaluation of each NNUE kernel set against the hand-written one.
+    const BenchResult* hand = nullptr;
+    for (const BenchResult& r : rs)
+        if (r.name == "evaluate x20000") hand = &r;
+    if (hand && hand->ns_per_unit() > 0) {
+        md << "\n## NNUE vs evaluate ##\n"
+           << "| evaluation | ns/eval | vs evaluate |\n"
+           << "|---|---:|---:|\n"
+           << "| evaluate | " << fmt("%.1f", hand->ns_per_unit()) << " | 1.00x |\n";
+        for (const BenchResult& r : rs)
+            if (r.name.rfind("nnue evaluate", 0) == 0)
+                md << "| nnue " << r.name.substr(r.name.find('('))
+                   << " | " << fmt("%.1f", r.ns_per_unit()) << " | "
+                   << fmt("%.2fx", r.ns_per_unit() / hand->ns_per_unit()) << " |\n";
+    }
+    return md.str();
+}
+
+static std::string to_json(const std::vector<BenchResult>& rs, int warmup, int repeat) {
+    std::ostringstream js;
+    js << "{\n"
+       << "  \"date\": \"" << today() << "\",\n"
+       << "  \"commit\": \"" << json_escape(BENCH_COMMIT) << "\",\n"
+       << "  \"compiler\": \"" << json_escape(compiler()) << "\",\n"
+       << "  \"flags\": \"" << json_escape(BENCH_FLAGS) << "\",\n"
+       << "  \"cpu\": \"" << json_escape(cpu_model()) << "\",\n"
+       << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+       << "  \"warmup\": " << warmup << ",\n"
+       << "  \"repeat\": " << repeat << ",\n"
+       << "  \"results\": [\n";
+    for (size_t i = 0; i < rs.size(); ++i) {
+        const BenchResult& r = rs[i];
+        js << "    {\"name\": \"" << json_escape(r.name) << "\", \"unit\": \"" << r.unit
+           << "\", \"work\": " << r.work
+           << ", \"median_ms\": " << fmt("%.4f", r.median_ms)
+           << ", \"p95_ms\": " << fmt("%.4f", r.p95_ms)
+           << ", \"min_ms\": " << fmt("%.4f", r.min_ms)
+           << ", \"rate\": " << fmt("%.0f", r.rate())
+           << ", \"ns_per_unit\": " << fmt("%.2f", r.ns_per_unit()) << "}"
+           << (i + 1 < rs.size() ? "," : "") << "\n";
+    }
+    js << "  ]\n}\n";
+    return js.str();
+}
+
+int main(int argc, char** argv) {
+    int warmup = 1, repeat = 5;
+    double threshold = 5.0;
+    std::string md_path, json_path, baseline_path;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> std::string { return i + 1 < argc ? argv[++i] : ""; };
+        if      (a == "--repeat")    repeat = std::max(1, std::atoi(next().c_str()));
+        else if (a == "--warmup")    warmup = std::max(0, std::atoi(next().c_str()));
+        else if (a == "--md")        md_path = next();
+        else if (a == "--json")      json_path = next();
+        else if (a == "--baseline")  baseline_path = next();
+        else if (a == "--threshold") threshold = std::atof(next().c_str());
+        else {
+            std::cerr << "usage: bench [--repeat N] [--warmup N] [--md FILE] [--json FILE]\n"
+                         "             [--baseline FILE.json] [--threshold PCT]\n";
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (const BenchCase& c : make_cases()) {
+        results.push_back(measure(c, warmup, repeat));
+        const BenchResult& r = results.back();
+        std::cerr << r.name << ": median " << fmt("%.3f", r.median_ms) << " ms, p95 "
+                  << fmt("%.3f", r.p95_ms) << " ms, " << fmt("%.0f", r.rate()) << " " << r.unit << "/s, "
+                  << fmt("%.1f", r.ns_per_unit()) << " ns each\n";
+    }
+
+    std::vector<Comparison> cmp;
+    bool regressed = false;
+    if (!baseline_path.empty()) {
+        std::map<std::string, BaselineEntry> base = read_baseline(baseline_path);
+        for (const BenchResult& r : results) {
+            Comparison c;
+            auto it = base.find(r.name);
+            if (it != base.end() && it->second.ns_per_unit > 0) {
+                c.have = true;
+                c.base_ns = it->second.ns_per_unit;
+                c.base_work = it->second.work;
+                c.delta_pct = (r.ns_per_unit() - c.base_ns) / c.base_ns * 100.0;
+                c.regressed = c.delta_pct > threshold;
+                c.work_changed = c.base_work != r.work;
+                regressed |= c.regressed;
+                if (c.work_changed)
+                    std::cerr << r.name << ": work changed, " << c.base_work << " -> " << r.work
+                              << " " << r.unit << "\n";
+            }
+            cmp.push_back(c);
+        }
+    }
+
+    std::string md = markdown(results, cmp, warmup, repeat, threshold);
+    if (md_path.empty()) std::cout << md;
+    else std::ofstream(md_path) << md;
+    if (!json_path.empty()) std::ofstream(json_path) << to_json(results, warmup, repeat);
+
+    if (regressed) {
+        std::cerr << "performance regression above " << threshold << "% against " << baseline_path << "\n";
+        return 3;
+    }
+    return 0;
+}
@@ -3,19 +3,34 @@
 #include <sstream>
 #include <vector>
 #include <cctype>
+#include <cstring>
 #include <stdexcept>
 #include <utility>
+#include <tuple>
 #include <algorithm>
 #include <cmath>
 #include <optional>
 #include <memory>
 #include <cassert>
+#include <cstdint>
+#include <bit>
+#include <type_traits>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <fstream>
+#include <iterator>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 constexpr int ROWS = 8;
 constexpr int COLS = 8;
 
-class Board; // forward declare
-
 // -------------------- Color helpers --------------------
 enum class Color { White, Black, None };
 
@@ -31,125 +46,270 @@ inline Color other(Color c) {
            c == Color::Black ? Color::White : Color::None;
 }
 
-// ==================== Piece base ====================
-class Piece {
-public:
-    Color color = Color::None;     // piece side
-    bool hasMoved = false;         // castling & pawn double-steps
-
-    explicit Piece(Color col = Color::None) : color(col) {}
-    virtual ~Piece() = default;
-
-    virtual std::string display() const { return "?"; }
-
-    // Pseudo-legal: does not check for self-check, etc.
-    virtual bool can_move(const Board &b, int r0, int c0, int r1, int c1) const = 0;
-
-    // Deep copy (for copying positions)
-    virtual std::unique_ptr<Piece> clone() const = 0;
+// ==================== Bitboard basics ====================
+// Squares are numbered sq = r*8 + c, so (0,0) is a1 and (7,7) is h8.
+// Bit 'sq' of a Bitboard is set when that square is part of the set.
+using Bitboard = std::uint64_t;
+
+inline int to_sq(int r, int c) { return r * COLS + c; }
+inline int row_of(int sq) { return sq >> 3; }
+inline int col_of(int sq) { return sq & 7; }
+
+inline Bitboard bit(int sq) { return Bitboard(1) << sq; }
+inline int popcount(Bitboard b) { return std::popcount(b); }
+inline int lsb(Bitboard b) { return std::countr_zero(b); }
+inline int pop_lsb(Bitboard& b) { int s = lsb(b); b &= b - 1; return s; }
+
+// -------------------- Piece codes --------------------
+// A piece is a small integer: color*6 + type. NO_PIECE marks an empty square.
+enum PieceType { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, NO_TYPE };
+constexpr int NO_PIECE = 12;
+
+inline int make_piece(Color c, int type) { return int(c) * 6 + type; }
+inline int type_of(int pc) { return pc == NO_PIECE ? NO_TYPE : pc % 6; }
+inline Color color_of(int pc) {
+    return pc == NO_PIECE ? Color::None : (pc < 6 ? Color::White : Color::Black);
+}
+inline char piece_char(int pc) { return "PNBRQKpnbrqk-"[pc]; }
+
+// ==================== Attack tables ====================
+// Leaper attacks are plain per-square tables. Slider attacks use "fancy"
+// magic bitboards: the relevant blockers are hashed into a per-square slice
+// of a shared table. With BMI2 (build with -mbmi2 or -march=native) the
+// hash is a single PEXT instead of a multiply; the tables are the same.
+// Everything is filled once at startup (see init_attack_tables below).
+#if defined(__BMI2__) && !defined(NO_PEXT)
+#include <immintrin.h>
+#define USE_PEXT 1
+#endif
+
+struct Magic {
+    Bitboard  mask = 0;      // relevant blockers (board edges excluded)
+    Bitboard  magic = 0;     // unused with PEXT
+    Bitboard* attacks = nullptr;
+    int       shift = 0;
+
+    unsigned index(Bitboard occupied) const {
+#ifdef USE_PEXT
+        return unsigned(_pext_u64(occupied, mask));
+#else
+        return unsigned(((occupied & mask) * magic) >> shift);
+#endif
+    }
 };
 
-class Pawn : public Piece {
-public:
-    explicit Pawn(Color col) : Piece(col) {}
-    std::string display() const override { return (color == Color::White) ? "P" : "p"; }
-    bool can_move(const Board& b, int r0, int c0, int r1, int c1) const override;
-    std::unique_ptr<Piece> clone() const override { return std::make_unique<Pawn>(*this); }
-};
+inline Bitboard PAWN_ATTACKS[2][64];
+inline Bitboard KNIGHT_ATTACKS[64];
+inline Bitboard KING_ATTACKS[64];
+inline Bitboard BETWEEN[64][64];    // squares strictly between two aligned squares
+inline Bitboard LINE[64][64];       // full line through two aligned squares (0 if not aligned)
+
+inline Magic    ROOK_MAGICS[64];
+inline Magic    BISHOP_MAGICS[64];
+inline Bitboard ROOK_TABLE[0x19000];  // 102400 entries: sum of 2^bits over all squares
+inline Bitboard BISHOP_TABLE[0x1480]; // 5248 entries
+
+constexpr int ROOK_DIRS[4][2]   = {{1,0},{-1,0},{0,1},{0,-1}};
+constexpr int BISHOP_DIRS[4][2] = {{1,1},{1,-1},{-1,1},{-1,-1}};
+
+// Ray walk used to build the tables: stops on (and includes) the first blocker.
+inline Bitboard sliding_attacks(const int (&dirs)[4][2], int sq, Bitboard occupied) {
+    Bitboard att = 0;
+    for (auto& d : dirs) {
+        int r = row_of(sq) + d[0], c = col_of(sq) + d[1];
+        while (r >= 0 && r < ROWS && c >= 0 && c < COLS) {
+            att |= bit(to_sq(r, c));
+            if (occupied & bit(to_sq(r, c))) break;
+            r += d[0]; c += d[1];
+        }
+    }
+    return att;
+}
 
-class Knight : public Piece {
-public:
-    explicit Knight(Color col) : Piece(col) {}
-    std::string display() const override { return (color == Color::White) ? "N" : "n"; }
-    bool can_move(const Board& b, int r0, int c0, int r1, int c1) const override;
-    std::unique_ptr<Piece> clone() const override { return std::make_unique<Knight>(*this); }
+inline Bitboard bishop_attacks(int sq, Bitboard occupied) {
+    const Magic& m = BISHOP_MAGICS[sq];
+    return m.attacks[m.index(occupied)];
+}
+inline Bitboard rook_attacks(int sq, Bitboard occupied) {
+    const Magic& m = ROOK_MAGICS[sq];
+    return m.attacks[m.index(occupied)];
+}
+inline Bitboard queen_attacks(int sq, Bitboard occupied) {
+    return bishop_attacks(sq, occupied) | rook_attacks(sq, occupied);
+}
+inline Bitboard knight_attacks(int sq) { return KNIGHT_ATTACKS[sq]; }
+inline Bitboard king_attacks(int sq) { return KING_ATTACKS[sq]; }
+inline Bitboard pawn_attacks(Color c, int sq) { return PAWN_ATTACKS[int(c)][sq]; }
+
+// Deterministic xorshift64* so the magic search is reproducible run to run.
+struct MagicRng {
+    std::uint64_t s;
+    std::uint64_t next() { s ^= s >> 12; s ^= s << 25; s ^= s >> 27; return s * 2685821657736338717ULL; }
+    std::uint64_t sparse() { return next() & next() & next(); }
 };
 
-class Bishop : public Piece {
-public:
-    explicit Bishop(Color col) : Piece(col) {}
-    std::string display() const override { return (color == Color::White) ? "B" : "b"; }
-    bool can_move(const Board& b, int r0, int c0, int r1, int c1) const override;
-    std::unique_ptr<Piece> clone() const override { return std::make_unique<Bishop>(*this); }
-};
+inline void init_magics(const int (&dirs)[4][2], Magic* magics, Bitboard* table) {
+    Bitboard reference[4096];
+#ifndef USE_PEXT
+    Bitboard occupancy[4096];
+    int epoch[4096] = {}, cnt = 0;
+    // Per-rank seeds known to converge quickly for this generator.
+    static const std::uint64_t seeds[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+#endif
+    Bitboard* next_slice = table;
+
+    for (int sq = 0; sq < 64; ++sq) {
+        Magic& m = magics[sq];
+        // Edges only matter if the piece stands on them.
+        Bitboard edges = ((0xFFULL | 0xFF00000000000000ULL) & ~(0xFFULL << (8 * row_of(sq))))
+                       | ((0x0101010101010101ULL | 0x8080808080808080ULL) &
+                          ~(0x0101010101010101ULL << col_of(sq)));
+        m.mask = sliding_attacks(dirs, sq, 0) & ~edges;
+        int bits = popcount(m.mask);
+        m.shift = 64 - bits;
+        m.attacks = next_slice;
+
+        // Enumerate every blocker subset of the mask (Carry-Rippler).
+        int size = 0;
+        Bitboard sub = 0;
+        do {
+            reference[size] = sliding_attacks(dirs, sq, sub);
+#ifdef USE_PEXT
+            m.attacks[_pext_u64(sub, m.mask)] = reference[size];
+#else
+            occupancy[size] = sub;
+#endif
+            ++size;
+            sub = (sub - m.mask) & m.mask;
+        } while (sub);
+        next_slice += size;
+
+#ifndef USE_PEXT
+        MagicRng rng{seeds[row_of(sq)]};
+        // Try sparse random multipliers until one maps all subsets without
+        // destructive collisions.
+        for (int i = 0; i < size; ) {
+            for (m.magic = 0; popcount((m.magic * m.mask) >> 56) < 6; )
+                m.magic = rng.sparse();
+
+            ++cnt;
+            for (i = 0; i < size; ++i) {
+                unsigned idx = m.index(occupancy[i]);
+                if (epoch[idx] < cnt) {
+                    epoch[idx] = cnt;
+                    m.attacks[idx] = reference[i];
+                } else if (m.attacks[idx] != reference[i]) {
+                    break;
+                }
+            }
+        }
+#endif
+    }
+}
 
-class Rook : public Piece {
-public:
-    explicit Rook(Color col) : Piece(col) {}
-    std::string display() const override { return (color == Color::White) ? "R" : "r"; }
-    bool can_move(const Board& b, int r0, int c0, int r1, int c1) const override;
-    std::unique_ptr<Piece> clone() const override { return std::make_unique<Rook>(*this); }
-};
+inline void init_attack_tables() {
+    static const int knight_d[8][2] = {{2,1},{1,2},{-1,2},{-2,1},{-2,-1},{-1,-2},{1,-2},{2,-1}};
+    static const int king_d[8][2]   = {{1,0},{1,1},{0,1},{-1,1},{-1,0},{-1,-1},{0,-1},{1,-1}};
+
+    auto on_board = [](int r, int c) { return r >= 0 && r < ROWS && c >= 0 && c < COLS; };
+
+    for (int sq = 0; sq < 64; ++sq) {
+        int r = row_of(sq), c = col_of(sq);
+        for (auto& d : knight_d)
+            if (on_board(r + d[0], c + d[1])) KNIGHT_ATTACKS[sq] |= bit(to_sq(r + d[0], c + d[1]));
+        for (auto& d : king_d)
+            if (on_board(r + d[0], c + d[1])) KING_ATTACKS[sq] |= bit(to_sq(r + d[0], c + d[1]));
+        for (int dc : {-1, +1}) {
+            if (on_board(r + 1, c + dc)) PAWN_ATTACKS[int(Color::White)][sq] |= bit(to_sq(r + 1, c + dc));
+            if (on_board(r - 1, c + dc)) PAWN_ATTACKS[int(Color::Black)][sq] |= bit(to_sq(r - 1, c + dc));
+        }
+    }
 
-class Queen : public Piece {
-public:
-    explicit Queen(Color col) : Piece(col) {}
-    std::string display() const override { return (color == Color::White) ? "Q" : "q"; }
-    bool can_move(const Board& b, int r0, int c0, int r1, int c1) const override;
-    std::unique_ptr<Piece> clone() const override { return std::make_unique<Queen>(*this); }
-};
+    init_magics(ROOK_DIRS, ROOK_MAGICS, ROOK_TABLE);
+    init_magics(BISHOP_DIRS, BISHOP_MAGICS, BISHOP_TABLE);
 
-class King : public Piece {
-public:
-    explicit King(Color col) : Piece(col) {}
-    std::string display() const override { return (color == Color::White) ? "K" : "k"; }
-    bool can_move(const Board& b, int r0, int c0, int r1, int c1) const override;
-    std::unique_ptr<Piece> clone() const override { return std::make_unique<King>(*this); }
-};
+    for (int a = 0; a < 64; ++a)
+        for (int b = 0; b < 64; ++b) {
+            if (a == b) continue;
+            for (auto attacks : {&bishop_attacks, &rook_attacks}) {
+                if (attacks(a, 0) & bit(b)) {
+                    LINE[a][b]    = (attacks(a, 0) & attacks(b, 0)) | bit(a) | bit(b);
+                    BETWEEN[a][b] = attacks(a, bit(b)) & attacks(b, bit(a));
+                }
+            }
+        }
+}
 
-class Empty_Square : public Piece {
-public:
-    Empty_Square() : Piece(Color::None) {}
-    std::string display() const override { return "-"; }
-    bool can_move(const Board&, int, int, int, int) const override { return false; }
-    std::unique_ptr<Piece> clone() const override { return std::make_unique<Empty_Square>(*this); }
-};
+static const bool attack_tables_ready = (init_attack_tables(), true);
 
 // ==================== Board ====================
+// Plain-data position: one bitboard per colored piece, per-color occupancy,
+// and a mailbox for O(1) "what is on this square". Copying is a memcpy.
 class Board {
 public:
-    std::unique_ptr<Piece> board[ROWS][COLS]; // nullptr means empty
+    Bitboard pieces[12] = {};          // indexed by piece code
+    Bitboard occ[2] = {};              // indexed by int(Color)
+    Bitboard all = 0;                  // occ[0] | occ[1]
+    std::uint8_t squares[ROWS * COLS]; // piece code per square
+
+    Board() { std::fill(std::begin(squares), std::end(squares), std::uint8_t(NO_PIECE)); }
+
+    void put_piece(int pc, int sq) {
+        pieces[pc] |= bit(sq);
+        occ[int(color_of(pc))] |= bit(sq);
+        all |= bit(sq);
+        squares[sq] = std::uint8_t(pc);
+    }
 
-    Board() = default;
-    Board(const Board& other) {
-        for (int r=0;r<ROWS;++r)
-            for (int c=0;c<COLS;++c)
-                board[r][c] = other.board[r][c] ? other.board[r][c]->clone() : nullptr;
+    void remove_piece(int sq) {
+        int pc = squares[sq];
+        if (pc == NO_PIECE) return;
+        pieces[pc] &= ~bit(sq);
+        occ[int(color_of(pc))] &= ~bit(sq);
+        all &= ~bit(sq);
+        squares[sq] = NO_PIECE;
     }
-    Board& operator=(const Board& other){
-        if (this==&other) return *this;
-        for (int r=0;r<ROWS;++r)
-            for (int c=0;c<COLS;++c)
-                board[r][c] = other.board[r][c] ? other.board[r][c]->clone() : nullptr;
-        return *this;
+
+    // Moves whatever is on 'from' to an empty 'to'.
+    void move_piece(int from, int to) {
+        int pc = squares[from];
+        Bitboard ft = bit(from) | bit(to);
+        pieces[pc] ^= ft;
+        occ[int(color_of(pc))] ^= ft;
+        all ^= ft;
+        squares[to] = std::uint8_t(pc);
+        squares[from] = NO_PIECE;
     }
 
+    int piece_at(int r, int c) const { return squares[to_sq(r, c)]; }
+    char piece_char(int r, int c) const { return ::piece_char(piece_at(r, c)); }
+
+    Bitboard pieces_of(Color col, int type) const { return pieces[make_piece(col, type)]; }
+
     void set_major_pieces(Color color, int row) {
         // rooks
-        board[row][0] = std::make_unique<Rook>(color);
-        board[row][7] = std::make_unique<Rook>(color);
+        put_piece(make_piece(color, ROOK),   to_sq(row, 0));
+        put_piece(make_piece(color, ROOK),   to_sq(row, 7));
         // knights
-        board[row][1] = std::make_unique<Knight>(color);
-        board[row][6] = std::make_unique<Knight>(color);
+        put_piece(make_piece(color, KNIGHT), to_sq(row, 1));
+        put_piece(make_piece(color, KNIGHT), to_sq(row, 6));
         // bishops
-        board[row][2] = std::make_unique<Bishop>(color);
-        board[row][5] = std::make_unique<Bishop>(color);
+        put_piece(make_piece(color, BISHOP), to_sq(row, 2));
+        put_piece(make_piece(color, BISHOP), to_sq(row, 5));
         // queen & king
-        board[row][3] = std::make_unique<Queen>(color);
-        board[row][4] = std::make_unique<King>(color);
+        put_piece(make_piece(color, QUEEN),  to_sq(row, 3));
+        put_piece(make_piece(color, KING),   to_sq(row, 4));
 
         // pawns
         int pawn_row = (row == 0) ? 1 : 6;
         for (int j = 0; j < COLS; j++) {
-            board[pawn_row][j] = std::make_unique<Pawn>(color);
+            put_piece(make_piece(color, PAWN), to_sq(pawn_row, j));
         }
     }
 
     void create_board() {
-        // Place pieces (leave others as nullptr = empty)
         set_major_pieces(Color::White, 0);
         set_major_pieces(Color::Black, 7);
-        // Middle ranks remain nullptr (treated as empty).
     }
 
     void display_board() const {
@@ -192,8 +352,7 @@ public:
         for (int r = 0; r < ROWS; ++r) {
             std::cout << "  " << r << " " << V;
             for (int c = 0; c < COLS; ++c) {
-                char pc = board[r][c] ? board[r][c]->display()[0] : '-';
-                std::cout << " " << pc << " " << V;
+                std::cout << " " << piece_char(r, c) << " " << V;
             }
             std::cout << " " << r << "\n";
             if (r != ROWS - 1) mid_border();
@@ -208,169 +367,734 @@ public:
     }
 
     bool is_empty(int r, int c) const {
-        if (!board[r][c]) return true;
-        return (board[r][c]->color == Color::None) ||
-               (dynamic_cast<Empty_Square*>(board[r][c].get()) != nullptr);
+        return !(all & bit(to_sq(r, c)));
     }
 
     bool is_friend(int r, int c, Color col) const {
-        return !is_empty(r, c) && board[r][c]->color == col;
+        return col != Color::None && (occ[int(col)] & bit(to_sq(r, c)));
     }
 
     bool is_enemy(int r, int c, Color col) const {
-        return !is_empty(r, c) && board[r][c]->color != col;
+        return !is_empty(r, c) && color_of(piece_at(r, c)) != col;
     }
 
     // For sliders (rook/bishop/queen): check that squares between are empty.
     bool path_clear(int r0, int c0, int r1, int c1) const {
-        int dr = (r1 > r0) - (r1 < r0);  // -1,0,1
-        int dc = (c1 > c0) - (c1 < c0);  // -1,0,1
-        if (dr == 0 && dc == 0) return true;
-        int r = r0 + dr, c = c0 + dc;
-        while (r != r1 || c != c1) {
-            if (!in_bounds(r, c) || !is_empty(r, c)) return false;
-            r += dr; c += dc;
-        }
-        return true;
+        return !(BETWEEN[to_sq(r0, c0)][to_sq(r1, c1)] & all);
     }
 
     // Locate a king by color
     std::pair<int,int> king_pos(Color col) const {
-        for (int r = 0; r < ROWS; ++r)
-            for (int c = 0; c < COLS; ++c)
-                if (board[r][c] && board[r][c]->color == col && dynamic_cast<King*>(board[r][c].get()))
-                    return {r,c};
-        return {-1,-1};
+        Bitboard k = pieces_of(col, KING);
+        if (!k) return {-1,-1};
+        int s = lsb(k);
+        return {row_of(s), col_of(s)};
+    }
+
+    // Every piece (either color) attacking 'sq' given the occupancy 'occupied'.
+    Bitboard attackers_to(int sq, Bitboard occupied) const {
+        return (pawn_attacks(Color::Black, sq) & pieces_of(Color::White, PAWN))
+             | (pawn_attacks(Color::White, sq) & pieces_of(Color::Black, PAWN))
+             | (knight_attacks(sq) & (pieces[make_piece(Color::White, KNIGHT)] | pieces[make_piece(Color::Black, KNIGHT)]))
+             | (king_attacks(sq)   & (pieces[make_piece(Color::White, KING)]   | pieces[make_piece(Color::Black, KING)]))
+             | (bishop_attacks(sq, occupied) & (pieces[make_piece(Color::White, BISHOP)] | pieces[make_piece(Color::Black, BISHOP)] |
+                                                pieces[make_piece(Color::White, QUEEN)]  | pieces[make_piece(Color::Black, QUEEN)]))
+             | (rook_attacks(sq, occupied)   & (pieces[make_piece(Color::White, ROOK)]   | pieces[make_piece(Color::Black, ROOK)] |
+                                                pieces[make_piece(Color::White, QUEEN)]  | pieces[make_piece(Color::Black, QUEEN)]));
     }
 
     // Is square (r,c) attacked by any piece of 'attackerColor'?
     bool attacks_square(Color attackerColor, int r, int c) const {
-        auto inb = [&](int rr, int cc){ return rr>=0 && rr<ROWS && cc>=0 && cc<COLS; };
-        auto pawn_dir = [&](Color col){ return (col==Color::White) ? +1 : -1; };
-
-        for (int rr=0; rr<ROWS; ++rr) {
-            for (int cc=0; cc<COLS; ++cc) {
-                const Piece* p = board[rr][cc].get();
-                if (!p || p->color != attackerColor) continue;
-
-                // Knight
-                if (dynamic_cast<const Knight*>(p)) {
-                    int dr = std::abs(r-rr), dc = std::abs(c-cc);
-                    if ((dr==2 && dc==1) || (dr==1 && dc==2)) return true;
-                    continue;
-                }
-                // King
-                if (dynamic_cast<const King*>(p)) {
-                    int dr = std::abs(r-rr), dc = std::abs(c-cc);
-                    if (std::max(dr,dc)==1) return true;
-                    continue;
-                }
-                // Pawn (captures only diagonally)
-                if (dynamic_cast<const Pawn*>(p)) {
-                    int dir = pawn_dir(p->color);
-                    if (r == rr + dir && std::abs(c - cc) == 1) return true;
-                    continue;
-                }
-                // Bishop / Rook / Queen sliding
-                auto ray = [&](int drr, int dcc)->bool {
-                    int tr = rr + drr, tc = cc + dcc;
-                    while (inb(tr,tc)) {
-                        if (tr == r && tc == c) return true;
-                        if (!is_empty(tr,tc)) break;
-                        tr += drr; tc += dcc;
-                    }
-                    return false;
-                };
-                if (dynamic_cast<const Bishop*>(p) || dynamic_cast<const Queen*>(p)) {
-                    if (ray(+1,+1) || ray(+1,-1) || ray(-1,+1) || ray(-1,-1)) return true;
-                }
-                if (dynamic_cast<const Rook*>(p) || dynamic_cast<const Queen*>(p)) {
-                    if (ray(+1,0) || ray(-1,0) || ray(0,+1) || ray(0,-1)) return true;
-                }
-            }
-        }
-        return false;
+        return attacked_by(attackerColor, to_sq(r, c));
     }
+
+    // Same query by square index; checks the cheap leapers first.
+    // 'occupied' lets callers look through a piece that is about to move.
+    bool attacked_by(Color by, int sq, Bitboard occupied) const {
+        if (pawn_attacks(other(by), sq) & pieces_of(by, PAWN))   return true;
+        if (knight_attacks(sq) & pieces_of(by, KNIGHT))          return true;
+        if (king_attacks(sq) & pieces_of(by, KING))              return true;
+        Bitboard queens = pieces_of(by, QUEEN);
+        if (bishop_attacks(sq, occupied) & (pieces_of(by, BISHOP) | queens)) return true;
+        return (rook_attacks(sq, occupied) & (pieces_of(by, ROOK) | queens)) != 0;
+    }
+    bool attacked_by(Color by, int sq) const { return attacked_by(by, sq, all); }
+
+    // Pseudo-legal: does not check for self-check, castling or en passant.
+    bool can_move(int r0, int c0, int r1, int c1) const;
 };
+static_assert(std::is_trivially_copyable_v<Board>, "Board must stay memcpy-able");
 
 // ==================== Movement logic (pseudo-legal) ====================
-bool Pawn::can_move(const Board& b, int r0, int c0, int r1, int c1) const {
+bool Board::can_move(int r0, int c0, int r1, int c1) const {
+    int pc = piece_at(r0, c0);
+    Color color = color_of(pc);
+    if (pc == NO_PIECE) return false;
     if (r0 == r1 && c0 == c1) return false;
-    if (!b.in_bounds(r1, c1) || b.is_friend(r1, c1, color)) return false;
+    if (!in_bounds(r1, c1) || is_friend(r1, c1, color)) return false;
 
-    int dir = (color == Color::White) ? +1 : -1;     // white moves "down" (increasing row)
-    int start_row = (color == Color::White) ? 1 : 6; // white pawns start at row 1
+    int from = to_sq(r0, c0), to = to_sq(r1, c1);
 
-    int dr = r1 - r0;
-    int dc = c1 - c0;
+    switch (type_of(pc)) {
+    case PAWN: {
+        int dir = (color == Color::White) ? +1 : -1;     // white moves "down" (increasing row)
+        int start_row = (color == Color::White) ? 1 : 6; // white pawns start at row 1
+        int sdr = r1 - r0;
 
-    // Forward 1
-    if (dc == 0 && dr == dir && b.is_empty(r1, c1)) return true;
+        // Forward 1
+        if (c1 == c0 && sdr == dir && is_empty(r1, c1)) return true;
 
-    // Forward 2 from start
-    if (dc == 0 && dr == 2*dir && r0 == start_row) {
-        int midr = r0 + dir;
-        if (b.is_empty(midr, c0) && b.is_empty(r1, c1)) return true;
+        // Forward 2 from start
+        if (c1 == c0 && sdr == 2*dir && r0 == start_row) {
+            int midr = r0 + dir;
+            if (is_empty(midr, c0) && is_empty(r1, c1)) return true;
+        }
+
+        // Diagonal capture (en passant handled at Game level)
+        return (pawn_attacks(color, from) & bit(to)) && is_enemy(r1, c1, color);
     }
+    case KNIGHT: return (knight_attacks(from) & bit(to)) != 0;
+    case BISHOP: return (bishop_attacks(from, all) & bit(to)) != 0;
+    case ROOK:   return (rook_attacks(from, all) & bit(to)) != 0;
+    case QUEEN:  return (queen_attacks(from, all) & bit(to)) != 0;
+    case KING:   return (king_attacks(from) & bit(to)) != 0; // castling handled by Game
+    }
+    return false;
+}
 
-    // Diagonal capture
-    if (std::abs(dc) == 1 && dr == dir && b.is_enemy(r1, c1, color)) return true;
+// ==================== Move lists ====================
+// 16-bit move: bits 0-5 origin, 6-11 destination, 12-15 flags.
+// Flag bit 2 marks captures and bit 3 promotions; the low two bits then
+// select the promoted piece (knight..queen). Move() is the null move.
+class Move {
+    std::uint16_t data = 0;
 
-    // En passant handled at Game level
-    return false;
+public:
+    enum Flag : int {
+        QUIET = 0, DOUBLE_PUSH = 1, KING_CASTLE = 2, QUEEN_CASTLE = 3,
+        CAPTURE = 4, EP_CAPTURE = 5,
+        PROMOTION = 8, PROMO_CAPTURE = 12
+    };
+
+    constexpr Move() = default;
+    constexpr Move(int from, int to, int flags = QUIET)
+        : data(std::uint16_t(from | (to << 6) | (flags << 12))) {}
+
+    // Promotion to 'type' (KNIGHT..QUEEN), optionally capturing.
+    static constexpr Move promotion(int from, int to, int type, bool capture) {
+        return Move(from, to, (capture ? PROMO_CAPTURE : PROMOTION) | (type - KNIGHT));
+    }
+
+    constexpr int from() const  { return data & 63; }
+    constexpr int to() const    { return (data >> 6) & 63; }
+    constexpr int flags() const { return data >> 12; }
+
+    constexpr bool is_capture() const     { return flags() & CAPTURE; }
+    constexpr bool is_promotion() const   { return flags() & PROMOTION; }
+    constexpr bool is_ep() const          { return flags() == EP_CAPTURE; }
+    constexpr bool is_castle() const      { return flags() == KING_CASTLE || flags() == QUEEN_CASTLE; }
+    constexpr bool is_double_push() const { return flags() == DOUBLE_PUSH; }
+    constexpr int  promotion_type() const { return KNIGHT + (flags() & 3); }
+
+    constexpr std::uint16_t raw() const { return data; }
+    static constexpr Move from_raw(std::uint16_t raw) { Move m; m.data = raw; return m; }
+    constexpr explicit operator bool() const { return data != 0; }
+    constexpr bool operator==(const Move&) const = default;
+};
+static_assert(sizeof(Move) == 2, "Move must stay 16 bits");
+
+// Engine-internal text form "rc rc", with a promotion letter when needed ("64 74n").
+inline std::string to_string(Move m) {
+    std::string s;
+    s += char('0' + row_of(m.from())); s += char('0' + col_of(m.from()));
+    s += ' ';
+    s += char('0' + row_of(m.to()));   s += char('0' + col_of(m.to()));
+    if (m.is_promotion()) s += "nbrq"[m.promotion_type() - KNIGHT];
+    return s;
 }
 
-bool Knight::can_move(const Board& b, int r0, int c0, int r1, int c1) const {
-    if (r0 == r1 && c0 == c1) return false;
-    if (!b.in_bounds(r1, c1) || b.is_friend(r1, c1, color)) return false;
-    int dr = std::abs(r1 - r0), dc = std::abs(c1 - c0);
-    return (dr == 2 && dc == 1) || (dr == 1 && dc == 2);
+// Long algebraic as used by UCI and perft "divide": "e2e4", "e7e8q".
+inline std::string to_uci(Move m) {
+    std::string s;
+    s += char('a' + col_of(m.from())); s += char('1' + row_of(m.from()));
+    s += char('a' + col_of(m.to()));   s += char('1' + row_of(m.to()));
+    if (m.is_promotion()) s += "nbrq"[m.promotion_type() - KNIGHT];
+    return s;
 }
 
-bool Bishop::can_move(const Board& b, int r0, int c0, int r1, int c1) const {
-    if (r0 == r1 && c0 == c1) return false;
-    if (!b.in_bounds(r1, c1) || b.is_friend(r1, c1, color)) return false;
-    int dr = std::abs(r1 - r0), dc = std::abs(c1 - c0);
-    if (dr != dc) return false;
-    return b.path_clear(r0, c0, r1, c1);
+// Fixed-capacity list filled by the generator; no position has more than
+// 218 legal moves, so 256 slots never overflow.
+struct MoveList {
+    Move moves[256];
+    int count = 0;
+
+    void add(Move m) { moves[count++] = m; }
+    int size() const { return count; }
+    bool empty() const { return count == 0; }
+    const Move* begin() const { return moves; }
+    const Move* end() const { return moves + count; }
+};
+
+// Generation stages. CAPTURES also carries promotions and en passant, so
+// CAPTURES followed by QUIETS yields every move exactly once.
+enum GenType { CAPTURES, QUIETS, ALL_MOVES };
+
+// ==================== Zobrist keys ====================
+// One random 64-bit key per (piece, square), castling-rights set, EP file
+// and side to move. A position's key is the XOR of the keys that apply.
+inline std::uint64_t ZOBRIST_PIECE[12][64];
+inline std::uint64_t ZOBRIST_CASTLING[16];
+inline std::uint64_t ZOBRIST_EP_FILE[8];
+inline std::uint64_t ZOBRIST_SIDE; // XORed in when Black is to move
+
+inline void init_zobrist() {
+    MagicRng rng{1070372};
+    for (auto& per_piece : ZOBRIST_PIECE)
+        for (auto& k : per_piece) k = rng.next();
+    for (auto& k : ZOBRIST_CASTLING) k = rng.next();
+    for (auto& k : ZOBRIST_EP_FILE) k = rng.next();
+    ZOBRIST_SIDE = rng.next();
 }
 
-bool Rook::can_move(const Board& b, int r0, int c0, int r1, int c1) const {
-    if (r0 == r1 && c0 == c1) return false;
-    if (!b.in_bounds(r1, c1) || b.is_friend(r1, c1, color)) return false;
-    if (r0 != r1 && c0 != c1) return false;
-    return b.path_clear(r0, c0, r1, c1);
+static const bool zobrist_ready = (init_zobrist(), true);
+
+// ==================== Piece-square tables ====================
+// Indexed by PieceType. The king's value only matters to exchange counting,
+// where it must outweigh everything else.
+constexpr int PIECE_VALUE[7] = {100, 320, 330, 500, 900, 20000, 0};
+
+// Positional bonuses for White, written as seen from White's side: the
+// first row is rank 8. Pieces other than pawns and kings use the same table
+// in the middlegame and the endgame.
+namespace pst {
+constexpr int PAWN_MG[64] = {
+      0,  0,  0,  0,  0,  0,  0,  0,
+     50, 50, 50, 50, 50, 50, 50, 50,
+     10, 10, 20, 30, 30, 20, 10, 10,
+      5,  5, 10, 25, 25, 10,  5,  5,
+      0,  0,  0, 20, 20,  0,  0,  0,
+      5, -5,-10,  0,  0,-10, -5,  5,
+      5, 10, 10,-20,-20, 10, 10,  5,
+      0,  0,  0,  0,  0,  0,  0,  0 };
+constexpr int PAWN_EG[64] = {
+      0,  0,  0,  0,  0,  0,  0,  0,
+     80, 80, 80, 80, 80, 80, 80, 80,
+     50, 50, 50, 50, 50, 50, 50, 50,
+     30, 30, 30, 30, 30, 30, 30, 30,
+     20, 20, 20, 20, 20, 20, 20, 20,
+     10, 10, 10, 10, 10, 10, 10, 10,
+     10, 10, 10, 10, 10, 10, 10, 10,
+      0,  0,  0,  0,  0,  0,  0,  0 };
+constexpr int KNIGHT[64] = {
+    -50,-40,-30,-30,-30,-30,-40,-50,
+    -40,-20,  0,  0,  0,  0,-20,-40,
+    -30,  0, 10, 15, 15, 10,  0,-30,
+    -30,  5, 15, 20, 20, 15,  5,-30,
+    -30,  0, 15, 20, 20, 15,  0,-30,
+    -30,  5, 10, 15, 15, 10,  5,-30,
+    -40,-20,  0,  5,  5,  0,-20,-40,
+    -50,-40,-30,-30,-30,-30,-40,-50 };
+constexpr int BISHOP[64] = {
+    -20,-10,-10,-10,-10,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5, 10, 10,  5,  0,-10,
+    -10,  5,  5, 10, 10,  5,  5,-10,
+    -10,  0, 10, 10, 10, 10,  0,-10,
+    -10, 10, 10, 10, 10, 10, 10,-10,
+    -10,  5,  0,  0,  0,  0,  5,-10,
+    -20,-10,-10,-10,-10,-10,-10,-20 };
+constexpr int ROOK[64] = {
+      0,  0,  0,  0,  0,  0,  0,  0,
+      5, 10, 10, 10, 10, 10, 10,  5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+     -5,  0,  0,  0,  0,  0,  0, -5,
+      0,  0,  0,  5,  5,  0,  0,  0 };
+constexpr int QUEEN[64] = {
+    -20,-10,-10, -5, -5,-10,-10,-20,
+    -10,  0,  0,  0,  0,  0,  0,-10,
+    -10,  0,  5,  5,  5,  5,  0,-10,
+     -5,  0,  5,  5,  5,  5,  0, -5,
+      0,  0,  5,  5,  5,  5,  0, -5,
+    -10,  5,  5,  5,  5,  5,  0,-10,
+    -10,  0,  5,  0,  0,  0,  0,-10,
+    -20,-10,-10, -5, -5,-10,-10,-20 };
+constexpr int KING_MG[64] = {
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -30,-40,-40,-50,-50,-40,-40,-30,
+    -20,-30,-30,-40,-40,-30,-30,-20,
+    -10,-20,-20,-20,-20,-20,-20,-10,
+     20, 20,  0,  0,  0,  0, 20, 20,
+     20, 30, 10,  0,  0, 10, 30, 20 };
+constexpr int KING_EG[64] = {
+    -50,-40,-30,-20,-20,-30,-40,-50,
+    -30,-20,-10,  0,  0,-10,-20,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 30, 40, 40, 30,-10,-30,
+    -30,-10, 20, 30, 30, 20,-10,-30,
+    -30,-30,  0,  0,  0,  0,-30,-30,
+    -50,-30,-30,-30,-30,-30,-30,-50 };
+
+constexpr const int* MG[6] = {PAWN_MG, KNIGHT, BISHOP, ROOK, QUEEN, KING_MG};
+constexpr const int* EG[6] = {PAWN_EG, KNIGHT, BISHOP, ROOK, QUEEN, KING_EG};
+} // namespace pst
+
+// Material plus position per piece code and square, White-positive: what
+// Game adds and removes as pieces come and go.
+inline int PSQ_MG[12][64];
+inline int PSQ_EG[12][64];
+
+inline void init_psq() {
+    for (int type = PAWN; type <= KING; ++type)
+        for (int sq = 0; sq < 64; ++sq) {
+            int value = type == KING ? 0 : PIECE_VALUE[type];
+            int w = (7 - row_of(sq)) * 8 + col_of(sq); // table index for White on sq
+            int bl = sq;                               // Black sees the board flipped
+            PSQ_MG[make_piece(Color::White, type)][sq] =   value + pst::MG[type][w];
+            PSQ_EG[make_piece(Color::White, type)][sq] =   value + pst::EG[type][w];
+            PSQ_MG[make_piece(Color::Black, type)][sq] = -(value + pst::MG[type][bl]);
+            PSQ_EG[make_piece(Color::Black, type)][sq] = -(value + pst::EG[type][bl]);
+        }
 }
 
-bool Queen::can_move(const Board& b, int r0, int c0, int r1, int c1) const {
-    if (r0 == r1 && c0 == c1) return false;
-    if (!b.in_bounds(r1, c1) || b.is_friend(r1, c1, color)) return false;
-    int dr = std::abs(r1 - r0), dc = std::abs(c1 - c0);
-    if (!(r0 == r1 || c0 == c1 || dr == dc)) return false;
-    return b.path_clear(r0, c0, r1, c1);
+static const bool psq_ready = (init_psq(), true);
+
+// PSQ_MG and PSQ_EG summed over a board.
+inline std::pair<int, int> psq_sums(const Board& b) {
+    int mg = 0, eg = 0;
+    for (int pc = 0; pc < 12; ++pc) {
+        Bitboard bb = b.pieces[pc];
+        while (bb) {
+            int sq = pop_lsb(bb);
+            mg += PSQ_MG[pc][sq];
+            eg += PSQ_EG[pc][sq];
+        }
+    }
+    return {mg, eg};
 }
 
-bool King::can_move(const Board& b, int r0, int c0, int r1, int c1) const {
-    if (r0 == r1 && c0 == c1) return false;
-    if (!b.in_bounds(r1, c1) || b.is_friend(r1, c1, color)) return false;
-    int dr = std::abs(r1 - r0), dc = std::abs(c1 - c0);
-    // Normal king move (castling handled by Game)
-    return std::max(dr, dc) == 1 || (dr==0 && std::abs(c1-c0)==2);
+// ==================== Neural evaluation (NNUE) ====================
+// An efficiently updatable network: a wide first layer over piece/square
+// features whose output (the accumulator) Game keeps current move by move,
+// then two small integer layers computed at each leaf.
+//
+//   768 features -> 2 x 256 (int16) -> clip -> 32 (int8 weights) -> clip -> 1
+//
+// Each colour has its own half of the accumulator, seeing the board from
+// its side: ranks flipped for Black, pieces as "own" and "their" instead of
+// white and black. The side to move's half comes first in the next layer,
+// so the output is from the side to move's view.
+//
+// Weights come from a file (Network::load). None ships with the engine, so
+// the search uses the hand-written evaluate() unless one is given. The
+// vector work runs on AVX2, SSE4.1 or plain C++ kernels, picked at startup
+// from what the CPU supports.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NNUE_X86 1
+#endif
+
+namespace nnue {
+constexpr int INPUTS = 768;       // own/their x piece type x square
+constexpr int HIDDEN = 256;       // accumulator width per colour
+constexpr int L1 = 32;            // second layer outputs
+constexpr int CLIP = 127;         // activations are clipped to [0, CLIP] and passed on as uint8
+constexpr int L1_SHIFT = 6;       // second layer sums are divided by 2^L1_SHIFT
+constexpr int OUTPUT_SCALE = 16;  // network output units per centipawn
+
+inline int feature(Color perspective, int pc, int sq) {
+    int their = color_of(pc) == perspective ? 0 : 1;
+    return (their * 6 + type_of(pc)) * 64 + (perspective == Color::White ? sq : sq ^ 56);
 }
 
+struct alignas(64) Accumulator {
+    Accumulator() {} // left uninitialised: make_move pushes one per ply and overwrites it
+    std::int16_t v[2][HIDDEN]; // by int(Color)
+};
+
+// The feature changes of one move, gathered while Game edits the board and
+// applied in one go by Network::update. At most two pieces leave a square
+// and two arrive (castling); a promoting pawn arrives and leaves again on
+// the same square, which cancels out here.
+struct Delta {
+    static constexpr int MAX = 2;
+    std::int8_t add_pc[MAX], add_sq[MAX], sub_pc[MAX], sub_sq[MAX];
+    int adds = 0, subs = 0;
+
+    void clear() { adds = subs = 0; }
+    void add(int pc, int sq) {
+        add_pc[adds] = std::int8_t(pc);
+        add_sq[adds++] = std::int8_t(sq);
+    }
+    void sub(int pc, int sq) {
+        for (int k = 0; k < adds; ++k)
+            if (add_pc[k] == pc && add_sq[k] == sq) {
+                --adds;
+                add_pc[k] = add_pc[adds];
+                add_sq[k] = add_sq[adds];
+                return;
+            }
+        sub_pc[subs] = std::int8_t(pc);
+        sub_sq[subs++] = std::int8_t(sq);
+    }
+};
+
+// The vector primitives. add: acc[i] += w[i] over HIDDEN entries. update:
+// one move's change to a whole accumulator, out = in + the add rows - the
+// sub rows, over both halves (2*HIDDEN entries) with each entry loaded and
+// stored once; add and sub hold 'adds' and 'subs' rows for White's half,
+// then as many for Black's. clip: out[i] = clamp(in[i], 0, CLIP) over
+// HIDDEN entries. affine: the second layer, out[j] = bias[j] + sum of
+// x[i] * w[j][i] over 2*HIDDEN inputs for each of L1 outputs. Pairwise
+// products stay clear of int16 overflow because inputs are at most CLIP,
+// so every set gives the same results.
+struct Kernels {
+    const char* name;
+    void (*add)(std::int16_t* acc, const std::int16_t* w);
+    void (*update)(const std::int16_t* in, std::int16_t* out,
+                   const std::int16_t* const* add, int adds, const std::int16_t* const* sub, int subs);
+    void (*clip)(const std::int16_t* in, std::uint8_t* out);
+    void (*affine)(const std::uint8_t* x, const std::int8_t* w, const std::int32_t* bias, std::int32_t* out);
+};
+
+// update() is instantiated for each shape a move can have: one feature
+// added and one removed (a quiet move or a promotion), one and two (a
+// capture) or two and two (castling), so its loops over the rows unroll.
+#define NNUE_UPDATE_SHAPES(fn)                                   \
+    if (adds == 1 && subs == 1) fn<1, 1>(in, out, add, sub);     \
+    else if (adds == 1)         fn<1, 2>(in, out, add, sub);     \
+    else                        fn<2, 2>(in, out, add, sub);
+
+inline void add_scalar(std::int16_t* acc, const std::int16_t* w) {
+    for (int i = 0; i < HIDDEN; ++i) acc[i] = std::int16_t(acc[i] + w[i]);
+}
+template <int ADDS, int SUBS>
+inline void update_scalar_n(const std::int16_t* in, std::int16_t* out,
+                            const std::int16_t* const* add, const std::int16_t* const* sub) {
+    for (int c = 0; c < 2; ++c, in += HIDDEN, out += HIDDEN, add += ADDS, sub += SUBS)
+        for (int i = 0; i < HIDDEN; ++i) {
+            int v = in[i];
+            for (int k = 0; k < ADDS; ++k) v += add[k][i];
+            for (int k = 0; k < SUBS; ++k) v -= sub[k][i];
+            out[i] = std::int16_t(v);
+        }
+}
+inline void update_scalar(const std::int16_t* in, std::int16_t* out,
+                          const std::int16_t* const* add, int adds, const std::int16_t* const* sub, int subs) {
+    NNUE_UPDATE_SHAPES(update_scalar_n)
+}
+inline void clip_scalar(const std::int16_t* in, std::uint8_t* out) {
+    for (int i = 0; i < HIDDEN; ++i) out[i] = std::uint8_t(std::clamp<int>(in[i], 0, CLIP));
+}
+inline void affine_scalar(const std::uint8_t* x, const std::int8_t* w, const std::int32_t* bias, std::int32_t* out) {
+    for (int j = 0; j < L1; ++j, w += 2 * HIDDEN) {
+        std::int32_t s = bias[j];
+        for (int i = 0; i < 2 * HIDDEN; ++i) s += x[i] * w[i];
+        out[j] = s;
+    }
+}
+inline constexpr Kernels SCALAR_KERNELS{"scalar", add_scalar, update_scalar, clip_scalar, affine_scalar};
+
+#ifdef NNUE_X86
+__attribute__((target("sse4.1"))) inline void add_sse41(std::int16_t* acc, const std::int16_t* w) {
+    for (int i = 0; i < HIDDEN; i += 8) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(w + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + i), _mm_add_epi16(a, b));
+    }
+}
+template <int ADDS, int SUBS>
+__attribute__((target("sse4.1"))) inline void update_sse41_n(const std::int16_t* in, std::int16_t* out,
+                                                             const std::int16_t* const* add,
+                                                             const std::int16_t* const* sub) {
+    for (int c = 0; c < 2; ++c, in += HIDDEN, out += HIDDEN, add += ADDS, sub += SUBS)
+        for (int i = 0; i < HIDDEN; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+            for (int k = 0; k < ADDS; ++k)
+                v = _mm_add_epi16(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(add[k] + i)));
+            for (int k = 0; k < SUBS; ++k)
+                v = _mm_sub_epi16(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(sub[k] + i)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+        }
+}
+__attribute__((target("sse4.1"))) inline void update_sse41(const std::int16_t* in, std::int16_t* out,
+                                                           const std::int16_t* const* add, int adds,
+                                                           const std::int16_t* const* sub, int subs) {
+    NNUE_UPDATE_SHAPES(update_sse41_n)
+}
+__attribute__((target("sse4.1"))) inline void clip_sse41(const std::int16_t* in, std::uint8_t* out) {
+    const __m128i cap = _mm_set1_epi8(CLIP);
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        __m128i packed = _mm_min_epu8(_mm_packus_epi16(a, b), cap); // packus clamps below at 0
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+    }
+}
+// Four outputs at a time share each load of x; hadd then folds the four
+// row sums into one vector of results.
+__attribute__((target("sse4.1"))) inline void affine_sse41(const std::uint8_t* x, const std::int8_t* w,
+                                                           const std::int32_t* bias, std::int32_t* out) {
+    const __m128i ones = _mm_set1_epi16(1);
+    constexpr int N = 2 * HIDDEN;
+    for (int j = 0; j < L1; j += 4) {
+        const std::int8_t* row = w + j * N;
+        __m128i s0 = _mm_setzero_si128(), s1 = s0, s2 = s0, s3 = s0;
+        for (int i = 0; i < N; i += 16) {
+            __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+#define NNUE_TERM(r) _mm_madd_epi16(_mm_maddubs_epi16(in, \
+                         _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + (r) * N + i))), ones)
+            s0 = _mm_add_epi32(s0, NNUE_TERM(0));
+            s1 = _mm_add_epi32(s1, NNUE_TERM(1));
+            s2 = _mm_add_epi32(s2, NNUE_TERM(2));
+            s3 = _mm_add_epi32(s3, NNUE_TERM(3));
+#undef NNUE_TERM
+        }
+        __m128i sums = _mm_hadd_epi32(_mm_hadd_epi32(s0, s1), _mm_hadd_epi32(s2, s3));
+        sums = _mm_add_epi32(sums, _mm_loadu_si128(reinterpret_cast<const __m128i*>(bias + j)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), sums);
+    }
+}
+
+__attribute__((target("avx2"))) inline void add_avx2(std::int16_t* acc, const std::int16_t* w) {
+    for (int i = 0; i < HIDDEN; i += 16) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi16(a, b));
+    }
+}
+template <int ADDS, int SUBS>
+__attribute__((target("avx2"))) inline void update_avx2_n(const std::int16_t* in, std::int16_t* out,
+                                                           const std::int16_t* const* add,
+                                                           const std::int16_t* const* sub) {
+    for (int c = 0; c < 2; ++c, in += HIDDEN, out += HIDDEN, add += ADDS, sub += SUBS)
+        for (int i = 0; i < HIDDEN; i += 16) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+            for (int k = 0; k < ADDS; ++k)
+                v = _mm256_add_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(add[k] + i)));
+            for (int k = 0; k < SUBS; ++k)
+                v = _mm256_sub_epi16(v, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sub[k] + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), v);
+        }
+}
+__attribute__((target("avx2"))) inline void update_avx2(const std::int16_t* in, std::int16_t* out,
+                                                         const std::int16_t* const* add, int adds,
+                                                         const std::int16_t* const* sub, int subs) {
+    NNUE_UPDATE_SHAPES(update_avx2_n)
+}
+__attribute__((target("avx2"))) inline void clip_avx2(const std::int16_t* in, std::uint8_t* out) {
+    const __m256i cap = _mm256_set1_epi8(CLIP);
+    for (int i = 0; i < HIDDEN; i += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16));
+        // packus works per 128-bit lane; the permute puts the quarters back in order.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_min_epu8(packed, cap));
+    }
+}
+__attribute__((target("avx2"))) inline void affine_avx2(const std::uint8_t* x, const std::int8_t* w,
+                                                         const std::int32_t* bias, std::int32_t* out) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    constexpr int N = 2 * HIDDEN;
+    for (int j = 0; j < L1; j += 4) {
+        const std::int8_t* row = w + j * N;
+        __m256i s0 = _mm256_setzero_si256(), s1 = s0, s2 = s0, s3 = s0;
+        for (int i = 0; i < N; i += 32) {
+            __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + i));
+#define NNUE_TERM(r) _mm256_madd_epi16(_mm256_maddubs_epi16(in, \
+                         _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + (r) * N + i))), ones)
+            s0 = _mm256_add_epi32(s0, NNUE_TERM(0));
+            s1 = _mm256_add_epi32(s1, NNUE_TERM(1));
+            s2 = _mm256_add_epi32(s2, NNUE_TERM(2));
+            s3 = _mm256_add_epi32(s3, NNUE_TERM(3));
+#undef NNUE_TERM
+        }
+        // hadd works per 128-bit lane: add the lanes' partial results.
+        __m256i h = _mm256_hadd_epi32(_mm256_hadd_epi32(s0, s1), _mm256_hadd_epi32(s2, s3));
+        __m128i sums = _mm_add_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+        sums = _mm_add_epi32(sums, _mm_loadu_si128(reinterpret_cast<const __m128i*>(bias + j)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + j), sums);
+    }
+}
+
+inline constexpr Kernels SSE41_KERNELS{"sse4.1", add_sse41, update_sse41, clip_sse41, affine_sse41};
+inline constexpr Kernels AVX2_KERNELS{"avx2", add_avx2, update_avx2, clip_avx2, affine_avx2};
+#endif
+#undef NNUE_UPDATE_SHAPES
+
+// The kernel sets this CPU can run, fastest first.
+inline std::vector<const Kernels*> supported_kernels() {
+    std::vector<const Kernels*> sets;
+#ifdef NNUE_X86
+    __builtin_cpu_init(); // may run before libgcc's own initialiser
+    if (__builtin_cpu_supports("avx2"))   sets.push_back(&AVX2_KERNELS);
+    if (__builtin_cpu_supports("sse4.1")) sets.push_back(&SSE41_KERNELS);
+#endif
+    // Built for AVX-512 (-march=native on a recent CPU), the compiler
+    // vectorises the plain loops wider than the hand-written kernels go.
+#ifdef __AVX512BW__
+    sets.insert(sets.begin(), &SCALAR_KERNELS);
+#else
+    sets.push_back(&SCALAR_KERNELS);
+#endif
+    return sets;
+}
+
+inline const Kernels* kernels = supported_kernels().front(); // the set in use
+
+struct Network {
+    // File layout, all little-endian: "NNUE", then version, HIDDEN and L1
+    // as uint32, then the arrays below in declaration order.
+    static constexpr std::uint32_t MAGIC = 0x45554E4E; // "NNUE"
+    static constexpr std::uint32_t VERSION = 1;
+
+    alignas(64) std::int16_t ft_bias[HIDDEN];
+    alignas(64) std::int16_t ft_weight[INPUTS][HIDDEN];
+    alignas(64) std::int32_t l1_bias[L1];
+    alignas(64) std::int8_t  l1_weight[L1][2 * HIDDEN];
+    alignas(64) std::int8_t  out_weight[L1];
+    std::int32_t out_bias;
+
+    void add(Accumulator& acc, int pc, int sq) const {
+        for (Color c : {Color::White, Color::Black})
+            kernels->add(acc.v[int(c)], ft_weight[feature(c, pc, sq)]);
+    }
+
+    // 'next' is 'prev' after the move 'd' describes: one kernel call for
+    // both halves, reading 'prev' and writing 'next' without a copy first.
+    void update(const Accumulator& prev, Accumulator& next, const Delta& d) const {
+        const std::int16_t* add_rows[2 * Delta::MAX];
+        const std::int16_t* sub_rows[2 * Delta::MAX];
+        for (Color c : {Color::White, Color::Black}) {
+            for (int k = 0; k < d.adds; ++k)
+                add_rows[int(c) * d.adds + k] = ft_weight[feature(c, d.add_pc[k], d.add_sq[k])];
+            for (int k = 0; k < d.subs; ++k)
+                sub_rows[int(c) * d.subs + k] = ft_weight[feature(c, d.sub_pc[k], d.sub_sq[k])];
+        }
+        kernels->update(prev.v[0], next.v[0], add_rows, d.adds, sub_rows, d.subs);
+    }
+
+    // From scratch; Game keeps its accumulator equal to this incrementally.
+    Accumulator refresh(const Board& b) const {
+        Accumulator acc;
+        std::copy(std::begin(ft_bias), std::end(ft_bias), acc.v[0]);
+        std::copy(std::begin(ft_bias), std::end(ft_bias), acc.v[1]);
+        for (int pc = 0; pc < 12; ++pc) {
+            Bitboard bb = b.pieces[pc];
+            while (bb) add(acc, pc, pop_lsb(bb));
+        }
+        return acc;
+    }
+
+    // The remaining layers, in centipawns from 'stm's view. Works on the stack only.
+    int forward(const Accumulator& acc, Color stm) const {
+        alignas(64) std::uint8_t x[2 * HIDDEN];
+        kernels->clip(acc.v[int(stm)], x);
+        kernels->clip(acc.v[int(other(stm))], x + HIDDEN);
+        alignas(64) std::int32_t h[L1];
+        kernels->affine(x, &l1_weight[0][0], l1_bias, h);
+        std::int32_t out = out_bias;
+        for (int j = 0; j < L1; ++j)
+            out += std::clamp(h[j] >> L1_SHIFT, 0, CLIP) * out_weight[j];
+        return out / OUTPUT_SCALE;
+    }
+
+    bool load(const std::string& path, std::string& errmsg) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) { errmsg = "cannot open " + path; return false; }
+        std::uint32_t header[4] = {};
+        in.read(reinterpret_cast<char*>(header), sizeof header);
+        if (!in || header[0] != MAGIC || header[1] != VERSION) {
+            errmsg = path + " is not a version " + std::to_string(VERSION) + " network";
+            return false;
+        }
+        if (header[2] != std::uint32_t(HIDDEN) || header[3] != std::uint32_t(L1)) {
+            errmsg = path + " has other layer sizes than this build";
+            return false;
+        }
+        auto read = [&](auto& field) { in.read(reinterpret_cast<char*>(&field), sizeof field); };
+        read(ft_bias); read(ft_weight); read(l1_bias); read(l1_weight); read(out_weight); read(out_bias);
+        if (!in || in.peek() != std::ifstream::traits_type::eof()) {
+            errmsg = path + " has the wrong size";
+            return false;
+        }
+        return true;
+    }
+
+    bool save(const std::string& path, std::string& errmsg) const {
+        std::ofstream out(path, std::ios::binary);
+        const std::uint32_t header[4] = {MAGIC, VERSION, HIDDEN, L1};
+        out.write(reinterpret_cast<const char*>(header), sizeof header);
+        auto write = [&](const auto& field) { out.write(reinterpret_cast<const char*>(&field), sizeof field); };
+        write(ft_bias); write(ft_weight); write(l1_bias); write(l1_weight); write(out_weight); write(out_bias);
+        if (!out) { errmsg = "cannot write " + path; return false; }
+        return true;
+    }
+
+    // Reproducible noise in plausible ranges: for benchmarks and tests,
+    // which need a network of the right shape but not a strong one.
+    void randomize(std::uint64_t seed) {
+        MagicRng rng{seed | 1};
+        auto fill = [&](auto* p, std::size_t n, int range) {
+            for (std::size_t i = 0; i < n; ++i)
+                p[i] = std::remove_reference_t<decltype(*p)>(int(rng.next() % (2 * range + 1)) - range);
+        };
+        fill(ft_bias, HIDDEN, 32);
+        fill(&ft_weight[0][0], std::size_t(INPUTS) * HIDDEN, 24);
+        fill(l1_bias, L1, 2048);
+        fill(&l1_weight[0][0], std::size_t(L1) * 2 * HIDDEN, 32);
+        fill(out_weight, L1, 4);
+        out_bias = 0;
+    }
+};
+} // namespace nnue
+
 // ==================== Game + Minimax ====================
 struct Strategy; // fwd
 
+// Castling rights bits
+enum : int { WHITE_OO = 1, WHITE_OOO = 2, BLACK_OO = 4, BLACK_OOO = 8, ALL_CASTLING = 15 };
+
+// Rights that survive a move touching a square (king/rook home squares clear theirs).
+inline int castle_mask(int sq) {
+    switch (sq) {
+        case 4:  return ALL_CASTLING & ~(WHITE_OO | WHITE_OOO); // e1
+        case 7:  return ALL_CASTLING & ~WHITE_OO;               // h1
+        case 0:  return ALL_CASTLING & ~WHITE_OOO;              // a1
+        case 60: return ALL_CASTLING & ~(BLACK_OO | BLACK_OOO); // e8
+        case 63: return ALL_CASTLING & ~BLACK_OO;               // h8
+        case 56: return ALL_CASTLING & ~BLACK_OOO;              // a8
+        default: return ALL_CASTLING;
+    }
+}
+
+// State make_move cannot recompute when taking a move back.
+struct Undo {
+    std::uint8_t  captured;  // piece code removed by the move, or NO_PIECE
+    std::uint8_t  castling;
+    std::int8_t   ep_sq;
+    std::uint16_t halfmove;
+    int           psq_mg, psq_eg;
+    std::uint64_t key;
+};
+
 class Game {
     Board b;
     Color turn = Color::White;
-
-    struct EP {
-        bool valid = false;
-        int target_r = -1, target_c = -1;    // square capturing pawn moves TO
-        int captured_r = -1, captured_c = -1;// square of pawn to be removed
-        Color pawnColor = Color::None;       // color of pawn that double-moved
-    } ep;
+    int castling = ALL_CASTLING;  // WHITE_OO | WHITE_OOO | BLACK_OO | BLACK_OOO
+    int ep_sq = -1;               // square a capturing pawn moves TO, or -1
+    int halfmove = 0;             // plies since the last capture or pawn move
+    std::uint64_t key = 0;        // Zobrist key, kept current by make_move
+    int psq_mg = 0, psq_eg = 0;   // PSQ_MG/PSQ_EG sums over the board, likewise
+    std::vector<Undo> undo_stack; // one entry per make_move not yet taken back
+    const nnue::Network* net = nullptr;        // not owned; null: no accumulators
+    std::vector<nnue::Accumulator> acc_stack;  // current one last, one per make_move below it
+    nnue::Delta acc_delta;                     // the feature changes of the make_move under way
 
     static int c2i(char c) {
         if (c < '0' || c > '7') throw std::out_of_range("index not 0-7");
@@ -383,53 +1107,50 @@ class Game {
         return b.attacks_square(other(col), kr, kc);
     }
 
-    // Simulate (optionally removing an extra captured piece for EP), then restore.
-    bool leaves_self_in_check(int r0,int c0,int r1,int c1,
-                          std::optional<std::pair<int,int>> extra_capture = std::nullopt)
-    {
-        auto& from = b.board[r0][c0];
-        auto& to   = b.board[r1][c1];
-        if (!from) return true;
-
-        Color mover = from->color;
-
-        // Handle temporary EP removal (captured pawn behind the target square)
-        std::unique_ptr<Piece> ep_saved;
-        int er=-1, ec=-1;
-        if (extra_capture) {
-            er = extra_capture->first;
-            ec = extra_capture->second;
-            ep_saved = std::move(b.board[er][ec]); // temporarily remove captured pawn
+    // Board edits that keep the Zobrist key and the PSQ sums in step, and
+    // note the network features they change for make_move to apply.
+    void put_piece(int pc, int sq) {
+        b.put_piece(pc, sq);
+        key ^= ZOBRIST_PIECE[pc][sq];
+        psq_mg += PSQ_MG[pc][sq];
+        psq_eg += PSQ_EG[pc][sq];
+        if (net) acc_delta.add(pc, sq);
+    }
+    void remove_piece(int sq) {
+        int pc = b.squares[sq];
+        if (pc == NO_PIECE) return;
+        key ^= ZOBRIST_PIECE[pc][sq];
+        psq_mg -= PSQ_MG[pc][sq];
+        psq_eg -= PSQ_EG[pc][sq];
+        if (net) acc_delta.sub(pc, sq);
+        b.remove_piece(sq);
+    }
+    void move_piece(int from, int to) {
+        int pc = b.squares[from];
+        key ^= ZOBRIST_PIECE[pc][from] ^ ZOBRIST_PIECE[pc][to];
+        psq_mg += PSQ_MG[pc][to] - PSQ_MG[pc][from];
+        psq_eg += PSQ_EG[pc][to] - PSQ_EG[pc][from];
+        if (net) {
+            acc_delta.sub(pc, from);
+            acc_delta.add(pc, to);
         }
+        b.move_piece(from, to);
+    }
 
-        // ---- Proper capture simulation (no swap) ----
-        // Move 'from' to 'to', and *remove* whatever was in 'to' during the test.
-        std::unique_ptr<Piece> captured = std::move(to);   // may be null
-        std::unique_ptr<Piece> moving   = std::move(from); // must exist
-        to   = std::move(moving);                          // piece now at destination
-        // 'from' is now empty (nullptr)
-
-        bool check = in_check(mover);
-
-        // ---- Revert ----
-        from = std::move(to);           // move piece back to origin
-        to   = std::move(captured);     // restore captured piece (if any)
-        if (extra_capture) {
-            b.board[er][ec] = std::move(ep_saved); // restore EP-captured pawn
-        }
+    // The pawn removed by an en passant capture sits beside the mover, behind ep_sq.
+    int ep_victim_sq() const { return ep_sq + (turn == Color::White ? -COLS : +COLS); }
 
-        return check;
+    bool is_ep_capture(int r0, int c0, int r1, int c1) const {
+        int pc = b.piece_at(r0, c0);
+        if (type_of(pc) != PAWN || std::abs(c1 - c0) != 1) return false;
+        int dir = (color_of(pc) == Color::White) ? +1 : -1;
+        return r1 == r0 + dir && ep_sq == to_sq(r1, c1) && color_of(pc) == turn;
     }
 
     bool can_castle_king_side(Color col) const {
         int row = (col==Color::White) ? 0 : 7;
         int kcol = 4, rcol = 7;
-        const Piece* king = b.board[row][kcol].get();
-        const Piece* rook = b.board[row][rcol].get();
-        if (!king || !rook) return false;
-        if (!dynamic_cast<const King*>(king) || !dynamic_cast<const Rook*>(rook)) return false;
-        if (king->color!=col || rook->color!=col) return false;
-        if (king->hasMoved || rook->hasMoved) return false;
+        if (!(castling & (col==Color::White ? WHITE_OO : BLACK_OO))) return false;
         if (!b.path_clear(row, kcol, row, rcol)) return false;
         if (in_check(col)) return false;
         if (b.attacks_square(other(col), row, kcol+1)) return false;
@@ -440,12 +1161,7 @@ class Game {
     bool can_castle_queen_side(Color col) const {
         int row = (col==Color::White) ? 0 : 7;
         int kcol = 4, rcol = 0;
-        const Piece* king = b.board[row][kcol].get();
-        const Piece* rook = b.board[row][rcol].get();
-        if (!king || !rook) return false;
-        if (!dynamic_cast<const King*>(king) || !dynamic_cast<const Rook*>(rook)) return false;
-        if (king->color!=col || rook->color!=col) return false;
-        if (king->hasMoved || rook->hasMoved) return false;
+        if (!(castling & (col==Color::White ? WHITE_OOO : BLACK_OOO))) return false;
         if (!b.path_clear(row, kcol, row, rcol)) return false;
         if (in_check(col)) return false;
         if (b.attacks_square(other(col), row, kcol-1)) return false;
@@ -456,107 +1172,389 @@ class Game {
     void do_castle_king_side(Color col) {
         int row = (col==Color::White) ? 0 : 7;
         // king e->g (4->6), rook h->f (7->5)
-        auto& king = b.board[row][4];
-        auto& rook = b.board[row][7];
-        b.board[row][6] = std::move(king);
-        b.board[row][5] = std::move(rook);
-        b.board[row][4].reset();
-        b.board[row][7].reset();
-        b.board[row][6]->hasMoved = true;
-        b.board[row][5]->hasMoved = true;
+        move_piece(to_sq(row, 4), to_sq(row, 6));
+        move_piece(to_sq(row, 7), to_sq(row, 5));
+        castling &= castle_mask(to_sq(row, 4));
     }
 
     void do_castle_queen_side(Color col) {
         int row = (col==Color::White) ? 0 : 7;
         // king e->c (4->2), rook a->d (0->3)
-        auto& king = b.board[row][4];
-        auto& rook = b.board[row][0];
-        b.board[row][2] = std::move(king);
-        b.board[row][3] = std::move(rook);
-        b.board[row][4].reset();
-        b.board[row][0].reset();
-        b.board[row][2]->hasMoved = true;
-        b.board[row][3]->hasMoved = true;
+        move_piece(to_sq(row, 4), to_sq(row, 2));
+        move_piece(to_sq(row, 0), to_sq(row, 3));
+        castling &= castle_mask(to_sq(row, 4));
     }
 
-    void maybe_promote(int r1, int c1) {
-        if (!b.board[r1][c1]) return;
-        if (dynamic_cast<Pawn*>(b.board[r1][c1].get()) == nullptr) return;
-        // white promotes at row 7, black at row 0
-        if ((b.board[r1][c1]->color==Color::White && r1==7) ||
-            (b.board[r1][c1]->color==Color::Black && r1==0))
-        {
-            Color col = b.board[r1][c1]->color;
-            b.board[r1][c1] = std::make_unique<Queen>(col); // auto-queen
-            b.board[r1][c1]->hasMoved = true;
-        }
+    // Castling rights, key and PSQ sums are restored from the undo record by the caller.
+    void undo_castle(Color col, bool kingside) {
+        int row = (col==Color::White) ? 0 : 7;
+        b.move_piece(to_sq(row, kingside ? 6 : 2), to_sq(row, 4));
+        b.move_piece(to_sq(row, kingside ? 5 : 3), to_sq(row, kingside ? 7 : 0));
     }
 
     bool has_any_legal_move(Color col) {
-        for (int r0=0;r0<ROWS;++r0)
-            for (int c0=0;c0<COLS;++c0) {
-                Piece* p = b.board[r0][c0].get();
-                if (!p || p->color!=col) continue;
-
-                for (int r1=0;r1<ROWS;++r1)
-                    for (int c1=0;c1<COLS;++c1) {
-                        if (r0==r1 && c0==c1) continue;
-
-                        // Special: castling
-                        if (dynamic_cast<King*>(p) && r0==r1 && std::abs(c1-c0)==2) {
-                            if (c1>c0 ? can_castle_king_side(col) : can_castle_queen_side(col))
-                                return true;
-                            continue;
-                        }
-
-                        // En passant possibility
-                        if (dynamic_cast<Pawn*>(p) && std::abs(c1-c0)==1) {
-                            int dir = (col==Color::White)?+1:-1;
-                            if (r1==r0+dir && b.is_empty(r1,c1) && ep.valid
-                                && ep.target_r==r1 && ep.target_c==c1 && ep.pawnColor!=col) {
-                                if (!leaves_self_in_check(r0,c0,r1,c1, std::make_pair(ep.captured_r,ep.captured_c)))
-                                    return true;
-                                continue;
-                            }
-                        }
-
-                        // Normal pseudo-legal then legality check
-                        if (p->can_move(b,r0,c0,r1,c1)) {
-                            if (!leaves_self_in_check(r0,c0,r1,c1))
-                                return true;
-                        }
-                    }
-            }
-        return false;
+        if (col != turn) {
+            Game g = *this;
+            g.turn = col;
+            g.ep_sq = -1;
+            return g.has_any_legal_move(col);
+        }
+        MoveList list;
+        generate_legal(list);
+        return !list.empty();
+    }
+
+    // Own pieces standing alone between our king and an enemy slider.
+    Bitboard pinned_pieces(Color us, int ksq) const {
+        Color them = other(us);
+        Bitboard queens = b.pieces_of(them, QUEEN);
+        Bitboard snipers = (rook_attacks(ksq, 0)   & (b.pieces_of(them, ROOK)   | queens))
+                         | (bishop_attacks(ksq, 0) & (b.pieces_of(them, BISHOP) | queens));
+        Bitboard pinned = 0;
+        while (snipers) {
+            Bitboard between = BETWEEN[ksq][pop_lsb(snipers)] & b.all;
+            if (between && !(between & (between - 1)))
+                pinned |= between & b.occ[int(us)];
+        }
+        return pinned;
+    }
+
+    // Legality of a pseudo-legal move given the side to move's pins.
+    bool legal_given_pins(Move m, Bitboard pinned, int ksq) const {
+        Color them = other(turn);
+        int from = m.from(), to = m.to();
+
+        if (m.is_castle()) return true; // squares already vetted by can_castle_*
+
+        if (type_of(b.squares[from]) == KING)
+            return !b.attacked_by(them, to, b.all ^ bit(from));
+
+        if (m.is_ep()) {
+            // Two pieces leave the king's lines at once: re-check the sliders.
+            Bitboard occupied = (b.all ^ bit(from) ^ bit(ep_victim_sq())) | bit(to);
+            Bitboard queens = b.pieces_of(them, QUEEN);
+            return !(rook_attacks(ksq, occupied)   & (b.pieces_of(them, ROOK)   | queens))
+                && !(bishop_attacks(ksq, occupied) & (b.pieces_of(them, BISHOP) | queens));
+        }
+
+        return !(pinned & bit(from)) || (LINE[from][ksq] & bit(to));
+    }
+
+    void add_move(MoveList& list, int from, int to) const {
+        list.add(Move(from, to, b.squares[to] != NO_PIECE ? Move::CAPTURE : Move::QUIET));
+    }
+    void add_promotions(MoveList& list, int from, int to, bool capture) const {
+        for (int type = QUEEN; type >= KNIGHT; --type)
+            list.add(Move::promotion(from, to, type, capture));
     }
 
 public:
-    Game() { b.create_board(); }
-    Game(const Game& g) : b(g.b), turn(g.turn), ep(g.ep) {}
-    Game& operator=(const Game& g){ b=g.b; turn=g.turn; ep=g.ep; return *this; }
+    Game() {
+        b.create_board();
+        key = compute_key();
+        std::tie(psq_mg, psq_eg) = compute_psq();
+        undo_stack.reserve(256);
+    }
 
     void print() const { b.display_board(); }
 
     const Board& get_board() const { return b; }
     Color side_to_move() const { return turn; }
+    std::uint64_t hash() const { return key; }
+    int castling_rights() const { return castling; }   // WHITE_OO | ... bits
+    int ep_square() const { return ep_sq; }            // -1 unless a pawn can take there
+    int plies_played() const { return int(undo_stack.size()); } // since the last FEN/setup
+    int halfmove_clock() const { return halfmove; }
+
+    // Key from scratch; make_move keeps 'key' equal to this incrementally.
+    std::uint64_t compute_key() const {
+        std::uint64_t k = ZOBRIST_CASTLING[castling];
+        for (int pc = 0; pc < 12; ++pc) {
+            Bitboard bb = b.pieces[pc];
+            while (bb) k ^= ZOBRIST_PIECE[pc][pop_lsb(bb)];
+        }
+        if (ep_sq >= 0) k ^= ZOBRIST_EP_FILE[col_of(ep_sq)];
+        if (turn == Color::Black) k ^= ZOBRIST_SIDE;
+        return k;
+    }
+
+    // Midgame and endgame material + piece-square sums (White-positive),
+    // kept current incrementally like the key.
+    int psq_midgame() const { return psq_mg; }
+    int psq_endgame() const { return psq_eg; }
+
+    std::pair<int, int> compute_psq() const { return psq_sums(b); }
+
+    // Attach a network (null detaches it): from then on make_move keeps its
+    // accumulator current. Not owned; it must outlive the Game and its copies.
+    void set_network(const nnue::Network* n) {
+        net = n;
+        acc_stack.clear();
+        if (!net) return;
+        acc_stack.reserve(undo_stack.size() + 2 * 128); // game so far plus a deep search line
+        acc_stack.push_back(net->refresh(b));
+    }
+    const nnue::Network* network() const { return net; }
+    const nnue::Accumulator& accumulator() const { return acc_stack.back(); } // needs a network
+    bool accumulator_ok() const {
+        nnue::Accumulator fresh = net->refresh(b);
+        return std::memcmp(&fresh, &acc_stack.back(), sizeof fresh) == 0;
+    }
+
+    // --------- FEN ---------
+    static constexpr const char* STARTPOS_FEN =
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    void load_startpos() { std::string err; load_fen(STARTPOS_FEN, err); }
+
+    // Replaces the position. EPD-style FENs without the two move counters
+    // are accepted; the fullmove number is not tracked. On error the game
+    // is left unchanged.
+    bool load_fen(const std::string& fen, std::string& errmsg) {
+        std::istringstream ss(fen);
+        std::string placement, side, rights, ep;
+        int half = 0, full = 1;
+        if (!(ss >> placement >> side >> rights >> ep)) { errmsg = "FEN needs at least 4 fields"; return false; }
+        if (ss >> half) { if (!(ss >> full)) full = 1; }
+        if (half < 0 || full < 1) { errmsg = "Bad move counters"; return false; }
+
+        Board nb;
+        int r = 7, c = 0;
+        for (char ch : placement) {
+            if (ch == '/') {
+                if (c != COLS || r == 0) { errmsg = "Bad rank layout"; return false; }
+                --r; c = 0;
+            } else if (ch >= '1' && ch <= '8') {
+                c += ch - '0';
+                if (c > COLS) { errmsg = "Rank too long"; return false; }
+            } else {
+                const char* p = std::strchr("PNBRQKpnbrqk", ch);
+                if (!p || ch == '\0' || c >= COLS) { errmsg = std::string("Bad piece '") + ch + "'"; return false; }
+                nb.put_piece(int(p - "PNBRQKpnbrqk"), to_sq(r, c++));
+            }
+        }
+        if (r != 0 || c != COLS) { errmsg = "FEN board must have 8 ranks of 8 files"; return false; }
+        if (popcount(nb.pieces_of(Color::White, KING)) != 1 || popcount(nb.pieces_of(Color::Black, KING)) != 1) {
+            errmsg = "Each side needs exactly one king"; return false;
+        }
+        if ((nb.pieces_of(Color::White, PAWN) | nb.pieces_of(Color::Black, PAWN)) & 0xFF000000000000FFULL) {
+            errmsg = "Pawn on a back rank"; return false;
+        }
+
+        Color stm;
+        if (side == "w") stm = Color::White;
+        else if (side == "b") stm = Color::Black;
+        else { errmsg = "Side to move must be w or b"; return false; }
+
+        // Rights whose king or rook has left its square are dropped, since
+        // castling only checks that the path is empty.
+        int cr = 0;
+        if (rights != "-") {
+            for (char ch : rights) {
+                switch (ch) {
+                    case 'K': cr |= WHITE_OO;  break;
+                    case 'Q': cr |= WHITE_OOO; break;
+                    case 'k': cr |= BLACK_OO;  break;
+                    case 'q': cr |= BLACK_OOO; break;
+                    default: errmsg = "Bad castling field"; return false;
+                }
+            }
+        }
+        auto has = [&](int pc, int sq) { return nb.squares[sq] == pc; };
+        const int WK = make_piece(Color::White, KING), WR = make_piece(Color::White, ROOK);
+        const int BK = make_piece(Color::Black, KING), BR = make_piece(Color::Black, ROOK);
+        if (!has(WK, to_sq(0,4)) || !has(WR, to_sq(0,7))) cr &= ~WHITE_OO;
+        if (!has(WK, to_sq(0,4)) || !has(WR, to_sq(0,0))) cr &= ~WHITE_OOO;
+        if (!has(BK, to_sq(7,4)) || !has(BR, to_sq(7,7))) cr &= ~BLACK_OO;
+        if (!has(BK, to_sq(7,4)) || !has(BR, to_sq(7,0))) cr &= ~BLACK_OOO;
+
+        // Like make_move, keep the EP square only if a pawn can take on it.
+        int eps = -1;
+        if (ep != "-") {
+            if (ep.size() != 2 || ep[0] < 'a' || ep[0] > 'h' || ep[1] != (stm == Color::White ? '6' : '3')) {
+                errmsg = "Bad en passant square"; return false;
+            }
+            int sq = to_sq(ep[1] - '1', ep[0] - 'a');
+            if (pawn_attacks(other(stm), sq) & nb.pieces_of(stm, PAWN)) eps = sq;
+        }
+
+        // The side that just moved may not be left in check.
+        int their_king = lsb(nb.pieces_of(other(stm), KING));
+        if (nb.attackers_to(their_king, nb.all) & nb.occ[int(stm)]) {
+            errmsg = "Side not to move is in check"; return false;
+        }
+
+        b = nb;
+        turn = stm;
+        castling = cr;
+        ep_sq = eps;
+        halfmove = half;
+        undo_stack.clear();
+        key = compute_key();
+        std::tie(psq_mg, psq_eg) = compute_psq();
+        set_network(net);
+        return true;
+    }
+
+    std::string fen() const {
+        std::string f;
+        for (int r = 7; r >= 0; --r) {
+            int empty = 0;
+            for (int c = 0; c < COLS; ++c) {
+                int pc = b.piece_at(r, c);
+                if (pc == NO_PIECE) { ++empty; continue; }
+                if (empty) { f += char('0' + empty); empty = 0; }
+                f += piece_char(pc);
+            }
+            if (empty) f += char('0' + empty);
+            if (r) f += '/';
+        }
+        f += (turn == Color::White) ? " w " : " b ";
+        if (!castling) f += '-';
+        if (castling & WHITE_OO)  f += 'K';
+        if (castling & WHITE_OOO) f += 'Q';
+        if (castling & BLACK_OO)  f += 'k';
+        if (castling & BLACK_OOO) f += 'q';
+        f += ' ';
+        if (ep_sq < 0) f += '-';
+        else { f += char('a' + col_of(ep_sq)); f += char('1' + row_of(ep_sq)); }
+        f += ' ' + std::to_string(halfmove) + " 1";
+        return f;
+    }
+
+    // --------- Move generation ---------
+    // Pseudo-legal moves for the side to move. When in check only moves that
+    // capture the checker or block it (or move the king) are produced.
+    void generate(GenType type, MoveList& list) const {
+        Color us = turn, them = other(turn);
+        Bitboard own = b.occ[int(us)], enemy = b.occ[int(them)];
+        Bitboard empty = ~b.all;
+        int ksq = lsb(b.pieces_of(us, KING));
+
+        Bitboard checkers = b.attackers_to(ksq, b.all) & enemy;
+        Bitboard evasion = ~Bitboard(0);
+        if (checkers) evasion = BETWEEN[ksq][lsb(checkers)] | checkers;
+
+        bool caps = (type != QUIETS), quiets = (type != CAPTURES);
+        Bitboard targets = ((caps ? enemy : 0) | (quiets ? empty : 0)) & evasion;
+
+        // King moves are never restricted by the evasion mask.
+        Bitboard king_to = king_attacks(ksq) & ((caps ? enemy : 0) | (quiets ? empty : 0));
+        while (king_to) add_move(list, ksq, pop_lsb(king_to));
+
+        // Double check: only the king may move.
+        if (checkers & (checkers - 1)) return;
+
+        // ---- Pawns ----
+        int up = (us == Color::White) ? 8 : -8;
+        Bitboard last_rank = (us == Color::White) ? 0xFF00000000000000ULL : 0xFFULL;
+        Bitboard third_rank = (us == Color::White) ? 0xFF0000ULL : 0xFF0000000000ULL;
+        Bitboard pawns = b.pieces_of(us, PAWN);
+        auto push = [&](Bitboard bb) { return us == Color::White ? bb << 8 : bb >> 8; };
+
+        Bitboard single = push(pawns) & empty;
+        Bitboard dbl    = push(single & third_rank) & empty;
+        Bitboard promo  = single & last_rank & evasion;
+        single &= ~last_rank & evasion;
+        dbl &= evasion;
+
+        if (caps)
+            while (promo) { int to = pop_lsb(promo); add_promotions(list, to - up, to, false); }
+        if (quiets) {
+            while (single) { int to = pop_lsb(single); list.add(Move(to - up, to)); }
+            while (dbl)    { int to = pop_lsb(dbl);    list.add(Move(to - 2 * up, to, Move::DOUBLE_PUSH)); }
+        }
+        if (caps) {
+            Bitboard p = pawns;
+            while (p) {
+                int from = pop_lsb(p);
+                Bitboard att = pawn_attacks(us, from) & enemy & evasion;
+                while (att) {
+                    int to = pop_lsb(att);
+                    if (bit(to) & last_rank) add_promotions(list, from, to, true);
+                    else                     list.add(Move(from, to, Move::CAPTURE));
+                }
+            }
+            // En passant: legal as an evasion only if it removes the checker or blocks.
+            if (ep_sq >= 0 && ((bit(ep_sq) & evasion) || (bit(ep_victim_sq()) & checkers))) {
+                Bitboard att = pawn_attacks(them, ep_sq) & pawns;
+                while (att) list.add(Move(pop_lsb(att), ep_sq, Move::EP_CAPTURE));
+            }
+        }
+
+        // ---- Knights, bishops, rooks, queens ----
+        for (int type = KNIGHT; type <= QUEEN; ++type) {
+            Bitboard pcs = b.pieces_of(us, type);
+            while (pcs) {
+                int from = pop_lsb(pcs);
+                Bitboard att = type == KNIGHT ? knight_attacks(from)
+                             : type == BISHOP ? bishop_attacks(from, b.all)
+                             : type == ROOK   ? rook_attacks(from, b.all)
+                             :                  queen_attacks(from, b.all);
+                att &= targets & ~own;
+                while (att) add_move(list, from, pop_lsb(att));
+            }
+        }
+
+        // ---- Castling ----
+        if (quiets && !checkers) {
+            if (can_castle_king_side(us))  list.add(Move(ksq, ksq + 2, Move::KING_CASTLE));
+            if (can_castle_queen_side(us)) list.add(Move(ksq, ksq - 2, Move::QUEEN_CASTLE));
+        }
+    }
+
+    // Filters a pseudo-legal list in place down to legal moves.
+    void filter_legal(MoveList& list) const {
+        int ksq = lsb(b.pieces_of(turn, KING));
+        Bitboard pinned = pinned_pieces(turn, ksq);
+        int n = 0;
+        for (int i = 0; i < list.count; ++i)
+            if (legal_given_pins(list.moves[i], pinned, ksq))
+                list.moves[n++] = list.moves[i];
+        list.count = n;
+    }
+
+    // Captures first, then quiets, all legal.
+    void generate_legal(MoveList& list, GenType type = ALL_MOVES) const {
+        if (type == ALL_MOVES) {
+            generate(CAPTURES, list);
+            generate(QUIETS, list);
+        } else {
+            generate(type, list);
+        }
+        filter_legal(list);
+    }
 
-    // Accepts "P10 30" or "10 30"
-    bool parse_move(const std::string& line, int& r0,int& c0,int& r1,int& c1, char& pieceLetter) {
+    // Accepts "P10 30" or "10 30"; a trailing n/b/r/q picks the promotion piece.
+    bool parse_move(const std::string& line, int& r0,int& c0,int& r1,int& c1, char& pieceLetter, char& promo) {
         std::stringstream ss(line);
         std::string a,bm;
         if (!(ss>>a>>bm)) return false;
         int ooff = (std::isdigit(static_cast<unsigned char>(a[0])) ? 0 : 1);
-        if ((int)a.size() < ooff+2 || (int)bm.size()!=2) return false;
+        if ((int)a.size() < ooff+2 || bm.size() < 2 || bm.size() > 3) return false;
         pieceLetter = (ooff==0 ? '?' : a[0]);
+        promo = (bm.size()==3 ? char(std::tolower(static_cast<unsigned char>(bm[2]))) : 'q');
         r0 = c2i(a[ooff]); c0 = c2i(a[ooff+1]);
         r1 = c2i(bm[0]);   c1 = c2i(bm[1]);
         return true;
     }
 
-    // Make a full legal move; returns false if illegal
+    // The legal move from->to (promoting to 'promo' when relevant), or Move().
+    Move find_legal_move(int from, int to, char promo = 'q') const {
+        MoveList list;
+        generate_legal(list);
+        for (Move m : list) {
+            if (m.from() != from || m.to() != to) continue;
+            if (m.is_promotion() && "nbrq"[m.promotion_type() - KNIGHT] != promo) continue;
+            return m;
+        }
+        return Move();
+    }
+
+    // Make a full legal move from text; returns false if illegal
     bool move(const std::string& input, std::string& errmsg) {
-        int r0,c0,r1,c1; char letter='?';
-        if (!parse_move(input, r0,c0,r1,c1, letter)) {
+        int r0=0,c0=0,r1=0,c1=0; char letter='?', promo='q';
+        if (!parse_move(input, r0,c0,r1,c1, letter, promo)) {
             errmsg = "Format error. Use P10 30 or 10 30";
             return false;
         }
@@ -566,101 +1564,153 @@ public:
             return false;
         }
 
-        auto& src = b.board[r0][c0];
-        if (!src || dynamic_cast<Empty_Square*>(src.get())) {
+        int pc = b.piece_at(r0,c0);
+        if (pc == NO_PIECE) {
             errmsg = "No piece at origin";
             return false;
         }
-        if (src->color != turn) {
+        if (color_of(pc) != turn) {
             errmsg = std::string("It's ") + to_cstr(turn) + "'s turn";
             return false;
         }
 
         // Optional sanity: if a letter was supplied, check it matches
         if (letter!='?') {
-            char disp = src->display()[0];
+            char disp = piece_char(pc);
             if (std::tolower(static_cast<unsigned char>(disp)) != std::tolower(static_cast<unsigned char>(letter))) {
                 errmsg = "Piece letter doesn't match the origin square";
                 return false;
             }
         }
 
-        // ---------- Castling ----------
-        if (dynamic_cast<King*>(src.get()) && r0==r1 && std::abs(c1-c0)==2) {
-            bool kingside = (c1>c0);
-            if (kingside ? can_castle_king_side(turn) : can_castle_queen_side(turn)) {
-                if (kingside) do_castle_king_side(turn);
-                else          do_castle_queen_side(turn);
-                ep.valid = false; // EP cleared on any non-double-pawn move
-                turn = other(turn);
-                return true;
-            } else {
+        Move m = find_legal_move(to_sq(r0,c0), to_sq(r1,c1), promo);
+        if (!m) {
+            if (type_of(pc)==KING && r0==r1 && std::abs(c1-c0)==2)
                 errmsg = "Castling not allowed now";
-                return false;
-            }
+            else if (b.can_move(r0,c0,r1,c1) || is_ep_capture(r0,c0,r1,c1))
+                errmsg = "Move would leave king in check";
+            else
+                errmsg = "Illegal move for that piece";
+            return false;
         }
 
-        // ---------- En passant ----------
-        if (dynamic_cast<Pawn*>(src.get()) && std::abs(c1-c0)==1) {
-            int dir = (turn==Color::White)?+1:-1;
-            if (r1==r0+dir && b.is_empty(r1,c1) && ep.valid
-                && ep.target_r==r1 && ep.target_c==c1 && ep.pawnColor!=turn) {
+        make_move(m);
+        return true;
+    }
 
-                if (leaves_self_in_check(r0,c0,r1,c1, std::make_pair(ep.captured_r,ep.captured_c))) {
-                    errmsg = "Move would leave king in check";
-                    return false;
-                }
-                // perform EP capture
-                b.board[ep.captured_r][ep.captured_c].reset();
-                b.board[r1][c1] = std::move(b.board[r0][c0]);
-                b.board[r0][c0].reset();
-                b.board[r1][c1]->hasMoved = true;
-
-                maybe_promote(r1,c1);
-                ep.valid = false;
-                turn = other(turn);
-                return true;
+    // Play a move produced by the generator. No parsing and no legality check.
+    // Pushes an Undo record so unmake_move(m) can restore the position.
+    void make_move(Move m) {
+        int from = m.from(), to = m.to();
+        int captured = m.is_ep() ? make_piece(other(turn), PAWN)
+                     : m.is_capture() ? b.squares[to] : NO_PIECE;
+        undo_stack.push_back(Undo{std::uint8_t(captured), std::uint8_t(castling),
+                                  std::int8_t(ep_sq), std::uint16_t(halfmove),
+                                  psq_mg, psq_eg, key});
+        if (net) acc_delta.clear();
+
+        bool irreversible = captured != NO_PIECE || type_of(b.squares[from]) == PAWN;
+        halfmove = irreversible ? 0 : halfmove + 1;
+
+        // Castling and EP keys come out here and go back in for the new state.
+        key ^= ZOBRIST_CASTLING[castling];
+        if (ep_sq >= 0) key ^= ZOBRIST_EP_FILE[col_of(ep_sq)];
+
+        if (m.is_castle()) {
+            if (m.flags() == Move::KING_CASTLE) do_castle_king_side(turn);
+            else                                do_castle_queen_side(turn);
+        } else {
+            if (m.is_ep())           remove_piece(ep_victim_sq());
+            else if (m.is_capture()) remove_piece(to);
+            move_piece(from, to);
+            if (m.is_promotion()) {
+                remove_piece(to);
+                put_piece(make_piece(turn, m.promotion_type()), to);
             }
+            castling &= castle_mask(from) & castle_mask(to);
         }
 
-        // ---------- Normal move (pseudo-legal + king safety) ----------
-        if (!src->can_move(b,r0,c0,r1,c1)) {
-            errmsg = "Illegal move for that piece";
-            return false;
-        }
-        if (leaves_self_in_check(r0,c0,r1,c1)) {
-            errmsg = "Move would leave king in check";
-            return false;
+        // EP target only survives a double pawn push, and only matters (and
+        // is hashed) when an enemy pawn could actually take on it.
+        ep_sq = -1;
+        if (m.is_double_push() && (pawn_attacks(turn, (from + to) / 2) & b.pieces_of(other(turn), PAWN)))
+            ep_sq = (from + to) / 2;
+
+        key ^= ZOBRIST_CASTLING[castling] ^ ZOBRIST_SIDE;
+        if (ep_sq >= 0) key ^= ZOBRIST_EP_FILE[col_of(ep_sq)];
+        turn = other(turn);
+
+        if (net) {
+            acc_stack.emplace_back();
+            net->update(acc_stack[acc_stack.size() - 2], acc_stack.back(), acc_delta);
         }
 
-        // Execute normal move
-        b.board[r1][c1].reset(); // drop captured piece if any
-        b.board[r1][c1] = std::move(b.board[r0][c0]);
-        b.board[r0][c0].reset();
-        b.board[r1][c1]->hasMoved = true;
+#ifdef CHESS_HASH_DEBUG
+        assert(key == compute_key());
+        assert(std::make_pair(psq_mg, psq_eg) == compute_psq());
+        assert(!net || accumulator_ok());
+#endif
+    }
+
+    // Take back the last move made with make_move(m).
+    void unmake_move(Move m) {
+        int from = m.from(), to = m.to();
+        const Undo& u = undo_stack.back();
 
-        // EP bookkeeping
-        ep.valid = false;
-        if (dynamic_cast<Pawn*>(b.board[r1][c1].get())) {
-            int dir = (turn==Color::White)?+1:-1;
-            if (std::abs(r1 - r0) == 2) {
-                ep.valid = true;
-                ep.target_r = r0 + dir;
-                ep.target_c = c0;
-                ep.captured_r = r1;
-                ep.captured_c = c0;
-                ep.pawnColor  = turn;
+        turn = other(turn);
+        castling = u.castling;
+        ep_sq = u.ep_sq;
+        halfmove = u.halfmove;
+        key = u.key;
+        psq_mg = u.psq_mg;
+        psq_eg = u.psq_eg;
+
+        if (m.is_castle()) {
+            undo_castle(turn, m.flags() == Move::KING_CASTLE);
+        } else {
+            if (m.is_promotion()) {
+                b.remove_piece(to);
+                b.put_piece(make_piece(turn, PAWN), to);
             }
+            b.move_piece(to, from);
+            if (m.is_ep())                    b.put_piece(u.captured, ep_victim_sq());
+            else if (u.captured != NO_PIECE)  b.put_piece(u.captured, to);
         }
+        undo_stack.pop_back();
+        if (net) acc_stack.pop_back();
+
+#ifdef CHESS_HASH_DEBUG
+        assert(key == compute_key());
+        assert(std::make_pair(psq_mg, psq_eg) == compute_psq());
+        assert(!net || accumulator_ok());
+#endif
+    }
 
-        // Promotion
-        maybe_promote(r1,c1);
+    // Pass the turn, for null-move pruning; never call it while in check.
+    // Taken back by unmake_null_move(). Like an irreversible move it resets
+    // the halfmove clock, so no repetition is found across the pass.
+    void make_null_move() {
+        undo_stack.push_back(Undo{std::uint8_t(NO_PIECE), std::uint8_t(castling),
+                                  std::int8_t(ep_sq), std::uint16_t(halfmove),
+                                  psq_mg, psq_eg, key});
+        if (ep_sq >= 0) key ^= ZOBRIST_EP_FILE[col_of(ep_sq)];
+        ep_sq = -1;
+        key ^= ZOBRIST_SIDE;
+        halfmove = 0;
+        turn = other(turn);
+    }
 
-        // Switch sides
+    void unmake_null_move() {
+        const Undo& u = undo_stack.back();
         turn = other(turn);
-        return true;
+        ep_sq = u.ep_sq;
+        halfmove = u.halfmove;
+        key = u.key;
+        undo_stack.pop_back();
     }
 
+    bool in_check() const { return in_check(turn); } // side to move
+
     bool is_checkmate(Color col) {
         return in_check(col) && !has_any_legal_move(col);
     }
@@ -668,45 +1718,35 @@ public:
         return !in_check(col) && !has_any_legal_move(col);
     }
 
-    // --------- Move generation for search (reuses legality checks) ---------
-    std::vector<std::string> legal_moves() {
-        std::vector<std::string> out;
-        auto fmt = [](int r, int c){
-            std::string s; s.push_back(char('0'+r)); s.push_back(char('0'+c)); return s;
-        };
-
-        for (int r0=0;r0<ROWS;++r0) for (int c0=0;c0<COLS;++c0) {
-            Piece* p = b.board[r0][c0].get();
-            if (!p || p->color!=turn) continue;
-
-            for (int r1=0;r1<ROWS;++r1) for (int c1=0;c1<COLS;++c1) {
-                if (r0==r1 && c0==c1) continue;
-
-                // Castling
-                if (dynamic_cast<King*>(p) && r0==r1 && std::abs(c1-c0)==2) {
-                    bool ks = c1>c0;
-                    if (ks ? can_castle_king_side(turn) : can_castle_queen_side(turn))
-                        out.push_back(fmt(r0,c0) + " " + fmt(r1,c1));
-                    continue;
-                }
-
-                // En passant (mirror move() logic)
-                if (dynamic_cast<Pawn*>(p) && std::abs(c1-c0)==1) {
-                    int dir = (turn==Color::White)?+1:-1;
-                    if (r1==r0+dir && b.is_empty(r1,c1) && ep.valid
-                        && ep.target_r==r1 && ep.target_c==c1 && ep.pawnColor!=turn) {
-                        if (!leaves_self_in_check(r0,c0,r1,c1, std::make_pair(ep.captured_r,ep.captured_c)))
-                            out.push_back(fmt(r0,c0) + " " + fmt(r1,c1));
-                        continue;
-                    }
-                }
+    MoveList legal_moves() const {
+        MoveList list;
+        generate_legal(list);
+        return list;
+    }
 
-                // Normal moves
-                if (p->can_move(b,r0,c0,r1,c1) && !leaves_self_in_check(r0,c0,r1,c1))
-                    out.push_back(fmt(r0,c0) + " " + fmt(r1,c1));
-            }
+    // --------- Draw rules ---------
+    // The undo stack doubles as the key history: entry i holds the key
+    // before move i. Only positions since the last capture or pawn move
+    // (the last 'halfmove' plies) can repeat the current one, and only
+    // those with the same side to move, so the scan is short.
+    //
+    // An earlier occurrence within the last 'ply' plies (inside a search
+    // tree rooted there) is enough; older ones have to add up to a
+    // threefold repetition.
+    bool is_repetition(int ply = 0) const {
+        int n = int(undo_stack.size());
+        int limit = std::min(halfmove, n);
+        int seen = 0;
+        for (int i = 4; i <= limit; i += 2) {
+            if (undo_stack[n - i].key != key) continue;
+            if (i <= ply || ++seen == 2) return true;
         }
-        return out;
+        return false;
+    }
+
+    // A hundred plies without a capture or pawn move, unless the last one mated.
+    bool is_fifty_move_draw() const {
+        return halfmove >= 100 && (!in_check(turn) || !legal_moves().empty());
     }
 
     // --------- Interactive loops ---------
@@ -736,6 +1776,11 @@ public:
                 std::cout << "Stalemate! Draw.\n";
                 break;
             }
+            if (is_repetition() || is_fifty_move_draw()) {
+                b.display_board();
+                std::cout << (is_repetition() ? "Threefold repetition! Draw.\n" : "Fifty-move rule! Draw.\n");
+                break;
+            }
             if (in_check(turn)) {
                 std::cout << "Check on " << to_cstr(turn) << "!\n";
             }
@@ -745,99 +1790,1253 @@ public:
     void loop_with_strategies(Strategy* white, Strategy* black);
 };
 
+// Leaf nodes of the legal move tree 'depth' plies below 'g' (promotions
+// count once per piece). The generator's correctness check against
+// published counts, and the make/unmake benchmark; 'g' is left unchanged.
+inline std::uint64_t perft(Game& g, int depth) {
+    if (depth == 0) return 1;
+    MoveList moves;
+    g.generate_legal(moves);
+    std::uint64_t nodes = 0;
+    for (Move m : moves) {
+        g.make_move(m);
+        nodes += perft(g, depth - 1);
+        g.unmake_move(m);
+    }
+    return nodes;
+}
+
 // ==================== Evaluator ====================
+// Material and piece-square terms come ready-summed from Game; only
+// mobility is counted here, from attack bitboards. Midgame and endgame
+// scores are blended by the material left on the board (the game phase).
+constexpr int PHASE_WEIGHT[6] = {0, 1, 1, 2, 4, 0};
+constexpr int PHASE_TOTAL = 24;                    // both sides' starting pieces
+constexpr int MOBILITY_MG[6] = {0, 4, 5, 2, 1, 0}; // per attacked square not our own
+constexpr int MOBILITY_EG[6] = {0, 4, 5, 4, 2, 0};
+constexpr int TEMPO = 10;                          // bonus for having the move
+
+// 'mg' and 'eg' are the board's psq_sums(), which Game keeps ready.
+int evaluate(const Board& b, Color stm, int mg, int eg) {
+    int phase = 0;
+    for (Color c : {Color::White, Color::Black}) {
+        int sign = c == Color::White ? 1 : -1;
+        Bitboard targets = ~b.occ[int(c)];
+        for (int t = KNIGHT; t <= QUEEN; ++t) {
+            Bitboard bb = b.pieces_of(c, t);
+            phase += PHASE_WEIGHT[t] * popcount(bb);
+            while (bb) {
+                int sq = pop_lsb(bb);
+                Bitboard att = t == KNIGHT ? knight_attacks(sq)
+                             : t == BISHOP ? bishop_attacks(sq, b.all)
+                             : t == ROOK   ? rook_attacks(sq, b.all)
+                             : bishop_attacks(sq, b.all) | rook_attacks(sq, b.all);
+                int n = popcount(att & targets);
+                mg += sign * MOBILITY_MG[t] * n;
+                eg += sign * MOBILITY_EG[t] * n;
+            }
+        }
+    }
+    phase = std::min(phase, PHASE_TOTAL);
+
+    int score = (mg * phase + eg * (PHASE_TOTAL - phase)) / PHASE_TOTAL;
+    score += stm == Color::White ? TEMPO : -TEMPO;
+    return score; // positive = good for White
+}
+
 int evaluate(const Game& g) {
-    const Board& b = g.get_board();
+    return evaluate(g.get_board(), g.side_to_move(), g.psq_midgame(), g.psq_endgame());
+}
 
-    auto val = [&](const Piece* p)->int {
-        if (!p) return 0;
-        int s = (p->color==Color::White) ? +1 : -1;
-        if (dynamic_cast<const Pawn*>(p))   return 100*s;
-        if (dynamic_cast<const Knight*>(p)) return 320*s;
-        if (dynamic_cast<const Bishop*>(p)) return 330*s;
-        if (dynamic_cast<const Rook*>(p))   return 500*s;
-        if (dynamic_cast<const Queen*>(p))  return 900*s;
-        return 0; // King not scored here
-    };
+// The attached network's score, White-positive like evaluate(). Only the
+// last two layers are computed here; the accumulator is already current.
+int nnue_evaluate(const Game& g) {
+    Color stm = g.side_to_move();
+    int v = g.network()->forward(g.accumulator(), stm);
+    return stm == Color::White ? v : -v;
+}
 
-    int score = 0;
-    for (int r=0;r<ROWS;++r)
-        for (int c=0;c<COLS;++c)
-            score += val(b.board[r][c].get());
+// Static exchange evaluation: the material the mover expects to win on the
+// target square of 'm' if both sides keep recapturing there with their
+// least valuable piece, each free to stop when going on would lose more.
+// Sliders uncovered behind a capturer join in (x-rays); pins are ignored.
+int see(const Board& b, Move m) {
+    int from = m.from(), to = m.to();
+    int gain[32], d = 0;
+    gain[0] = m.is_ep() ? PIECE_VALUE[PAWN] : PIECE_VALUE[type_of(b.squares[to])];
+
+    Bitboard occ = b.all ^ bit(from);
+    if (m.is_ep()) occ ^= bit(to_sq(row_of(from), col_of(to)));
+    int on_square = type_of(b.squares[from]);
+    Color side = other(color_of(b.squares[from]));
+    Bitboard attackers = b.attackers_to(to, occ) & occ;
+
+    while (d < 31) {
+        ++d;
+        gain[d] = PIECE_VALUE[on_square] - gain[d - 1]; // if 'side' recaptures
+        if (std::max(-gain[d - 1], gain[d]) < 0) break;  // the result can't change any more
+
+        Bitboard ours = attackers & b.occ[int(side)];
+        if (!ours) break;
+        int t = PAWN;
+        while (!(ours & b.pieces_of(side, t))) ++t;
+        if (t == KING && (attackers & b.occ[int(other(side))])) break; // king takes last
+
+        Bitboard pc = ours & b.pieces_of(side, t);
+        occ ^= pc & (0 - pc);
+        attackers = b.attackers_to(to, occ) & occ;
+        on_square = t;
+        side = other(side);
+    }
+    while (--d > 0)
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    return gain[0];
+}
 
-    // Tiny mobility bonus for side to move
-    Game tmp = g;
-    int my_moves = (int)tmp.legal_moves().size();
-    score += (tmp.side_to_move()==Color::White ? +my_moves : -my_moves);
+// ==================== Batch evaluation ====================
+// Scoring large position sets offline (tuning data, analysis dumps)
+// without a Game per position: positions are stored packed and unpacked
+// straight into a Board on the evaluating thread.
+
+// A position in 32 bytes: the occupied squares, then their piece codes
+// four bits each in square order (a legal position has at most 32 men).
+struct PackedPosition {
+    std::uint64_t occupied = 0;
+    std::uint8_t  pieces[16] = {};
+    std::uint8_t  side = 0;       // int(Color) to move
+    std::uint8_t  castling = 0;   // WHITE_OO | ... bits
+    std::int8_t   ep_sq = -1;
+    std::uint8_t  halfmove = 0;   // capped at 255
+    std::uint8_t  reserved[4] = {};
+
+    // False (and left unchanged) when 'g' has more than 32 men.
+    bool pack(const Game& g) {
+        const Board& b = g.get_board();
+        if (popcount(b.all) > 32) return false;
+        *this = PackedPosition{};
+        occupied = b.all;
+        int i = 0;
+        for (Bitboard bb = b.all; bb; ++i) {
+            int pc = b.squares[pop_lsb(bb)];
+            pieces[i / 2] |= std::uint8_t(pc << (i % 2 * 4));
+        }
+        side = std::uint8_t(g.side_to_move());
+        castling = std::uint8_t(g.castling_rights());
+        ep_sq = std::int8_t(g.ep_square());
+        halfmove = std::uint8_t(std::min(g.halfmove_clock(), 255));
+        return true;
+    }
 
-    return score; // positive = good for White
+    // Into an empty board. Fills the piece bitboards and the mailbox first
+    // and derives the occupancy from them, rather than put_piece per man.
+    void unpack(Board& b) const {
+        int i = 0;
+        for (Bitboard bb = occupied; bb; ++i) {
+            int sq = pop_lsb(bb);
+            int pc = (pieces[i / 2] >> (i % 2 * 4)) & 15;
+            b.pieces[pc] |= bit(sq);
+            b.squares[sq] = std::uint8_t(pc);
+        }
+        for (int pc = 0; pc < 12; ++pc) b.occ[int(color_of(pc))] |= b.pieces[pc];
+        b.all = occupied;
+    }
+    Color side_to_move() const { return Color(side); }
+};
+static_assert(sizeof(PackedPosition) == 32);
+
+// Scores positions[0..count) into scores[0..count), White-positive: with
+// the network if one is given, else with evaluate(). The array is split
+// into one contiguous chunk per thread (threads <= 0: all cores); small
+// batches use fewer threads, as starting one costs more than it saves.
+// Each position is evaluated independently, so a batch scores exactly
+// like evaluate() or nnue_evaluate() one by one.
+void evaluate_batch(const PackedPosition* positions, int* scores, std::size_t count,
+                    const nnue::Network* net = nullptr, int threads = 0) {
+    constexpr std::size_t MIN_PER_THREAD = 4096;
+    auto run = [=](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            Board b;
+            positions[i].unpack(b);
+            Color stm = positions[i].side_to_move();
+            if (net) {
+                int v = net->forward(net->refresh(b), stm);
+                scores[i] = stm == Color::White ? v : -v;
+            } else {
+                auto [mg, eg] = psq_sums(b);
+                scores[i] = evaluate(b, stm, mg, eg);
+            }
+        }
+    };
+
+    if (threads <= 0) threads = int(std::max(1u, std::thread::hardware_concurrency()));
+    std::size_t workers = std::clamp<std::size_t>(count / MIN_PER_THREAD, 1, std::size_t(threads));
+    std::size_t chunk = (count + workers - 1) / workers;
+    std::vector<std::thread> pool;
+    for (std::size_t t = 1; t < workers; ++t)
+        pool.emplace_back(run, std::min(count, t * chunk), std::min(count, (t + 1) * chunk));
+    run(0, std::min(count, chunk));
+    for (std::thread& t : pool) t.join();
 }
 
+// ==================== Transposition table ====================
+// Fixed-size hash of search results, shared by every search thread without
+// locks. Each slot is two 64-bit words written independently: the packed
+// data and (key ^ data). A reader only accepts a slot when the XOR of the
+// two gives back its key, so a torn write from another thread simply
+// reads as a miss. Four slots fill one 64-byte cache line.
+enum Bound : int { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+
+struct TTEntry {
+    Move  move;
+    int   score = 0;
+    int   depth = 0;
+    Bound bound = BOUND_NONE;
+};
+
+class TranspositionTable {
+    struct Slot {
+        std::atomic<std::uint64_t> key_xor_data{0};
+        std::atomic<std::uint64_t> data{0};
+    };
+    struct alignas(64) Bucket { Slot slots[4]; };
+    static_assert(sizeof(Bucket) == 64, "one bucket per cache line");
+
+    std::unique_ptr<Bucket[]> buckets;
+    std::size_t mask = 0;          // bucket count - 1 (count is a power of two)
+    std::uint8_t generation = 0;   // 6-bit search counter used for aging
+
+    // data layout: move:16 | score:32 | depth:8 | bound:2 | generation:6
+    static std::uint64_t pack(Move m, int score, int depth, Bound bound, int gen) {
+        return std::uint64_t(m.raw())
+             | (std::uint64_t(std::uint32_t(score)) << 16)
+             | (std::uint64_t(std::uint8_t(depth)) << 48)
+             | (std::uint64_t(bound) << 56)
+             | (std::uint64_t(gen & 63) << 58);
+    }
+    static Move   move_of(std::uint64_t d)  { return Move::from_raw(std::uint16_t(d)); }
+    static int    score_of(std::uint64_t d) { return std::int32_t(std::uint32_t(d >> 16)); }
+    static int    depth_of(std::uint64_t d) { return std::int8_t(std::uint8_t(d >> 48)); }
+    static Bound  bound_of(std::uint64_t d) { return Bound((d >> 56) & 3); }
+    static int    gen_of(std::uint64_t d)   { return int(d >> 58); }
+
+    Bucket& bucket_for(std::uint64_t key) const { return buckets[key & mask]; }
+
+public:
+    explicit TranspositionTable(std::size_t mb = 16) { resize(mb); }
+
+    // Reallocates (and clears) to the largest power-of-two size within 'mb' megabytes.
+    void resize(std::size_t mb) {
+        std::size_t count = 1;
+        while (count * 2 * sizeof(Bucket) <= std::max<std::size_t>(mb, 1) << 20) count *= 2;
+        buckets = std::make_unique<Bucket[]>(count);
+        mask = count - 1;
+        generation = 0;
+    }
+
+    void clear() {
+        for (std::size_t i = 0; i <= mask; ++i)
+            for (Slot& s : buckets[i].slots) {
+                s.key_xor_data.store(0, std::memory_order_relaxed);
+                s.data.store(0, std::memory_order_relaxed);
+            }
+        generation = 0;
+    }
+
+    // Call once per root search so older entries become preferred victims.
+    void new_search() { generation = (generation + 1) & 63; }
+
+    bool probe(std::uint64_t key, TTEntry& out) const {
+        for (const Slot& s : bucket_for(key).slots) {
+            std::uint64_t d = s.data.load(std::memory_order_relaxed);
+            std::uint64_t k = s.key_xor_data.load(std::memory_order_relaxed);
+            if (d && (k ^ d) == key) {
+                out.move = move_of(d);
+                out.score = score_of(d);
+                out.depth = depth_of(d);
+                out.bound = bound_of(d);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void store(std::uint64_t key, Move move, int score, int depth, Bound bound) {
+        Bucket& bk = bucket_for(key);
+        Slot* victim = &bk.slots[0];
+        int victim_value = 1 << 30;
+
+        for (Slot& s : bk.slots) {
+            std::uint64_t d = s.data.load(std::memory_order_relaxed);
+            std::uint64_t k = s.key_xor_data.load(std::memory_order_relaxed);
+            if (!d || (k ^ d) == key) {
+                // Same position: keep the old best move if the new result has none.
+                if (d && !move) move = move_of(d);
+                victim = &s;
+                break;
+            }
+            // Prefer replacing shallow entries from older searches.
+            int age = (generation - gen_of(d)) & 63;
+            int value = depth_of(d) - 8 * age;
+            if (value < victim_value) { victim_value = value; victim = &s; }
+        }
+
+        std::uint64_t d = pack(move, score, depth, bound, generation);
+        victim->data.store(d, std::memory_order_relaxed);
+        victim->key_xor_data.store(key ^ d, std::memory_order_relaxed);
+    }
+
+    // Permille of sampled slots written by the current search (UCI "hashfull").
+    int hashfull() const {
+        int used = 0, sampled = 0;
+        for (std::size_t i = 0; i <= mask && i < 250; ++i)
+            for (const Slot& s : buckets[i].slots) {
+                std::uint64_t d = s.data.load(std::memory_order_relaxed);
+                used += (d && gen_of(d) == generation);
+                ++sampled;
+            }
+        return sampled ? used * 1000 / sampled : 0;
+    }
+};
+
+// ==================== Time management ====================
+// What the GUI asked for with "go". Unset values are -1 (or 0 for increments).
+struct SearchLimits {
+    int depth = 0;            // 0: no explicit depth
+    int movetime = -1;        // ms for this move
+    int wtime = -1, btime = -1;
+    int winc = 0, binc = 0;
+    int movestogo = 0;        // 0: sudden death
+    bool infinite = false;
+    bool ponder = false;      // thinking on the opponent's time until "ponderhit"
+};
+
+// Turns the clock into two budgets: a soft one after which no new
+// iteration is started, and a hard one that aborts the running iteration.
+// The budgets count from "go", or from "ponderhit" when the search began
+// as a ponder search: the time spent pondering was the opponent's.
+struct TimeManager {
+    using clock = std::chrono::steady_clock;
+    static constexpr std::int64_t MOVE_OVERHEAD_MS = 30; // GUI/IO latency reserve
+
+    clock::time_point start = clock::now();
+    std::atomic<clock::rep> budget_start{start.time_since_epoch().count()}; // moved by another thread
+    std::int64_t soft_ms = -1; // -1: unlimited
+    std::int64_t hard_ms = -1;
+    bool fixed_time = false;   // "movetime": use all of it
+
+    void init(const SearchLimits& lim, Color us) {
+        start = clock::now();
+        restart_budgets();
+        soft_ms = hard_ms = -1;
+        fixed_time = false;
+        if (lim.infinite) return;
+
+        if (lim.movetime >= 0) {
+            soft_ms = hard_ms = std::max<std::int64_t>(1, lim.movetime - MOVE_OVERHEAD_MS);
+            fixed_time = true;
+            return;
+        }
+
+        int time = (us == Color::White) ? lim.wtime : lim.btime;
+        int inc  = (us == Color::White) ? lim.winc  : lim.binc;
+        if (time < 0) return;
+
+        // Spread what is left over the moves we still expect to play.
+        int mtg = lim.movestogo > 0 ? std::min(lim.movestogo, 50) : 30;
+        std::int64_t usable = std::max<std::int64_t>(1, time - MOVE_OVERHEAD_MS);
+        soft_ms = std::min<std::int64_t>(usable, usable / mtg + inc * 3 / 4);
+        hard_ms = std::min<std::int64_t>(usable, soft_ms * 4);
+        if (lim.movestogo == 1) soft_ms = hard_ms = usable * 9 / 10;
+    }
+
+    void restart_budgets() {
+        budget_start.store(clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    bool has_budget() const { return hard_ms >= 0; }
+    std::int64_t elapsed_ms() const { // since "go", for reporting
+        return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - start).count();
+    }
+    std::int64_t budget_elapsed_ms() const {
+        clock::time_point from{clock::duration(budget_start.load(std::memory_order_relaxed))};
+        return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - from).count();
+    }
+    bool hard_expired() const { return hard_ms >= 0 && budget_elapsed_ms() >= hard_ms; }
+
+    // The next iteration typically costs more than all earlier ones together,
+    // so on a clock don't start one past half the soft budget.
+    bool stop_deepening() const {
+        if (soft_ms < 0) return false;
+        std::int64_t t = budget_elapsed_ms();
+        return fixed_time ? t >= soft_ms : t * 2 >= soft_ms;
+    }
+};
+
+// Reported after each completed iteration. Score is from the side to move's view.
+struct SearchInfo {
+    int depth = 0;
+    int score = 0;
+    std::uint64_t nodes = 0;
+    std::int64_t time_ms = 0;
+    std::uint64_t qnodes = 0; // the part of 'nodes' spent in quiescence search
+    int hashfull = 0;         // permille of the transposition table in use
+    std::vector<Move> pv;
+};
+
 // ==================== Strategy + Minimax ====================
 struct Strategy {
     virtual ~Strategy() = default;
-    virtual std::string select_move(const Game& g) = 0;
+    virtual Move select_move(const Game& g) = 0; // Move() when there is none
+};
+
+// A node's moves with one ordering score each. pick() performs a single
+// selection-sort step, so a node that cuts off on its first moves never
+// pays for sorting the rest.
+struct ScoredMoveList {
+    MoveList list;
+    int score[256];
+    int next = 0;
+
+    bool empty() const { return list.empty(); }
+    int picked() const { return next; }        // moves handed out so far
+
+    Move pick() {
+        if (next >= list.count) return Move();
+        int best = next;
+        for (int i = next + 1; i < list.count; ++i)
+            if (score[i] > score[best]) best = i;
+        std::swap(list.moves[next], list.moves[best]);
+        std::swap(score[next], score[best]);
+        return list.moves[next++];
+    }
+};
+
+// One search thread's private state. Under Lazy SMP every thread owns one and
+// the threads share nothing but the transposition table.
+struct SearchWorker {
+    static constexpr int MAX_PLY = 128;
+
+    Game pos;
+    int id = 0;                              // 0: the main thread
+    std::atomic<std::uint64_t> nodes{0};     // only its own thread writes; the main thread sums
+    std::atomic<std::uint64_t> qnodes{0};    // the quiescence share of 'nodes'
+    bool stopped = false;
+
+    // Ordering memory: quiet moves that cut off at the same ply (killers)
+    // and anywhere in the tree (butterfly history, by side/from/to).
+    Move killers[MAX_PLY][2] = {};
+    int history[2][64][64] = {};
+
+    // Triangular PV table: pv[ply] holds the best line found from 'ply' on,
+    // built from the line one ply deeper whenever a move raises alpha.
+    Move pv[MAX_PLY][MAX_PLY];
+    int pv_len[MAX_PLY] = {};
+
+    // Cutoff statistics: how often the first move tried already fails high.
+    std::uint64_t fail_high = 0, fail_high_first = 0;
+
+    void update_pv(int ply, Move m) {
+        pv[ply][0] = m;
+        std::copy(pv[ply + 1], pv[ply + 1] + pv_len[ply + 1], pv[ply] + 1);
+        pv_len[ply] = pv_len[ply + 1] + 1;
+    }
+
+    static std::uint64_t bump(std::atomic<std::uint64_t>& counter) {
+        std::uint64_t n = counter.load(std::memory_order_relaxed) + 1;
+        counter.store(n, std::memory_order_relaxed); // single writer: no locked add needed
+        return n;
+    }
+    std::uint64_t count_node() { return bump(nodes); }
+    std::uint64_t count_qnode() { bump(qnodes); return bump(nodes); }
+};
+
+// Selectivity settings. Depths are in plies, margins in centipawns.
+struct SearchParams {
+    int null_move_depth = 3;      // null-move pruning from this depth on
+    int null_move_reduction = 3;  // R; deeper nodes add depth/6
+    int lmr_depth = 3;            // late move reductions from this depth on
+    int lmr_moves = 3;            // moves searched at full depth before reducing
+    int lmr_base = 75;            // reduction = base/100 + ln(depth)*ln(move)*100/divisor
+    int lmr_divisor = 225;
+    int rfp_depth = 6;            // reverse futility pruning up to this depth
+    int rfp_margin = 80;          // per ply of depth
+    int futility_depth = 3;       // futility pruning of quiet moves up to this depth
+    int futility_margin = 120;    // per ply of depth
+};
+
+// Names and ranges for exposing SearchParams as UCI options.
+struct SearchParamSpec {
+    const char* name;
+    int SearchParams::*field;
+    int min, max;
+};
+
+inline constexpr SearchParamSpec SEARCH_PARAM_SPECS[] = {
+    {"NullMoveDepth",      &SearchParams::null_move_depth,     1, 64},
+    {"NullMoveReduction",  &SearchParams::null_move_reduction, 1, 8},
+    {"LmrDepth",           &SearchParams::lmr_depth,           1, 64},
+    {"LmrMoves",           &SearchParams::lmr_moves,           1, 64},
+    {"LmrBase",            &SearchParams::lmr_base,            0, 300},
+    {"LmrDivisor",         &SearchParams::lmr_divisor,         50, 1000},
+    {"RfpDepth",           &SearchParams::rfp_depth,           0, 16},
+    {"RfpMargin",          &SearchParams::rfp_margin,          0, 1000},
+    {"FutilityDepth",      &SearchParams::futility_depth,      0, 16},
+    {"FutilityMargin",     &SearchParams::futility_margin,     0, 1000},
 };
 
 struct MinimaxStrategy : Strategy {
-    int max_depth = 3; // start with 2–3
-
-    int search(Game& pos, int depth, int alpha, int beta) {
-        if (depth==0) return evaluate(pos);
-
-        auto moves = pos.legal_moves();
-        if (moves.empty()) {
-            if (pos.is_checkmate(pos.side_to_move()))
-                return (pos.side_to_move()==Color::White ? -100000 : +100000);
-            return 0; // stalemate
-        }
-
-        bool maxing = (pos.side_to_move()==Color::White);
-        if (maxing) {
-            int best = -1000000000;
-            for (auto& m : moves) {
-                Game child = pos; std::string err;
-                if (!child.move(m, err)) continue;
-                int sc = search(child, depth-1, alpha, beta);
-                best = std::max(best, sc);
-                alpha = std::max(alpha, sc);
-                if (beta <= alpha) break;
+    static constexpr int MAX_DEPTH = 64;
+    static constexpr int INF = 1000000000;
+    static constexpr int MATE = 100000;
+    static constexpr int DELTA_MARGIN = 200; // slack for positional gains in quiescence
+    static constexpr int ASPIRATION_WINDOW = 25; // initial half-width around the last score
+
+    int max_depth = 3;        // depth used when 'limits' sets neither depth nor time
+    int threads = 1;          // main thread + (threads-1) Lazy SMP helpers
+    SearchLimits limits;
+    SearchParams params;
+    TranspositionTable tt;
+    const nnue::Network* network = nullptr; // not owned; null: evaluate() instead
+    std::function<void(const SearchInfo&)> on_iteration; // e.g. UCI "info" output
+
+    std::uint64_t nodes = 0;   // all threads, last search
+    std::uint64_t qnodes = 0;  // the quiescence share of 'nodes'
+    std::uint64_t fail_high = 0, fail_high_first = 0; // all threads, last search
+    std::vector<Move> root_pv; // PV of the last completed iteration
+    TimeManager timer;
+    int reductions[64][64] = {}; // LMR plies by [depth][move number], from 'params'
+
+    // Written by the input thread while a search runs on another one. The
+    // caller clears 'stop_requested' before starting a search, so a "stop"
+    // that races with the start is not lost.
+    std::atomic<bool> stop_requested{false};
+    std::atomic<bool> pondering{false};   // budgets are ignored until ponderhit(), and start there
+    std::atomic<bool> helpers_stop{false}; // the main thread is done; helpers quit
+
+    // The budgets start now; release pairs with the acquire loads below, so
+    // a thread that sees pondering end also sees the new start.
+    void ponderhit() {
+        timer.restart_budgets();
+        pondering.store(false, std::memory_order_release);
+    }
+
+    bool should_stop() const {
+        return stop_requested.load(std::memory_order_relaxed)
+            || helpers_stop.load(std::memory_order_relaxed)
+            || (!pondering.load(std::memory_order_acquire) && timer.hard_expired());
+    }
+
+    // Ordering: TT move, then captures and promotions by MVV-LVA, the two
+    // killers, and the remaining quiets by history.
+    void score_moves(const SearchWorker& w, ScoredMoveList& ml, Move tt_move, int ply) const {
+        const Board& b = w.pos.get_board();
+        int us = int(w.pos.side_to_move());
+        const Move* killer = w.killers[std::min(ply, SearchWorker::MAX_PLY - 1)];
+        for (int i = 0; i < ml.list.count; ++i) {
+            Move m = ml.list.moves[i];
+            int& sc = ml.score[i];
+            if (m == tt_move)
+                sc = 1 << 30;
+            else if (m.is_capture() || m.is_promotion()) {
+                int victim = m.is_ep() ? PAWN : m.is_capture() ? type_of(b.squares[m.to()]) : 0;
+                int promo = m.is_promotion() ? m.promotion_type() : 0;
+                sc = (1 << 28) + 64 * (victim + promo) - type_of(b.squares[m.from()]);
             }
-            return best;
-        } else {
-            int best = +1000000000;
-            for (auto& m : moves) {
-                Game child = pos; std::string err;
-                if (!child.move(m, err)) continue;
-                int sc = search(child, depth-1, alpha, beta);
-                best = std::min(best, sc);
-                beta = std::min(beta, sc);
-                if (beta <= alpha) break;
+            else if (m == killer[0]) sc = (1 << 27) + 1;
+            else if (m == killer[1]) sc = (1 << 27);
+            else                     sc = w.history[us][m.from()][m.to()];
+        }
+    }
+
+    // A quiet move that caused a cutoff becomes a killer and gains history.
+    void update_quiet_stats(SearchWorker& w, Move m, int depth, int ply) {
+        if (m.is_capture() || m.is_promotion()) return;
+        Move* killer = w.killers[std::min(ply, SearchWorker::MAX_PLY - 1)];
+        if (killer[0] != m) { killer[1] = killer[0]; killer[0] = m; }
+        int& h = w.history[int(w.pos.side_to_move())][m.from()][m.to()];
+        h = std::min(h + depth * depth, 1 << 26); // stays below killer scores
+    }
+
+    // Mate scores count plies from the root so that shorter mates score
+    // higher. The table stores them relative to the node instead, so an
+    // entry stays right when reached at another ply.
+    static bool is_mate_score(int s) { return std::abs(s) >= MATE - SearchWorker::MAX_PLY; }
+    static int score_to_tt(int s, int ply)   { return is_mate_score(s) ? (s > 0 ? s + ply : s - ply) : s; }
+    static int score_from_tt(int s, int ply) { return is_mate_score(s) ? (s > 0 ? s - ply : s + ply) : s; }
+
+    static int static_eval(const Game& pos) {
+        int v = pos.network() ? nnue_evaluate(pos) : evaluate(pos);
+        return pos.side_to_move()==Color::White ? v : -v;
+    }
+
+    // Quiescence: play out captures (every evasion when in check) until the
+    // position is quiet enough for the static evaluation. The side to move
+    // may always "stand pat" on the evaluation instead of capturing.
+    // Captures that can't lift the score to alpha even with DELTA_MARGIN to
+    // spare, or that lose material by SEE, are skipped.
+    int qsearch(SearchWorker& w, int ply, int alpha, int beta) {
+        if ((w.count_qnode() & 1023) == 0 && should_stop()) w.stopped = true;
+        if (w.stopped) return 0;
+
+        if (ply < SearchWorker::MAX_PLY) w.pv_len[ply] = 0; // lines end here
+
+        Game& pos = w.pos;
+        bool checked = pos.in_check();
+        int stand_pat = -INF;
+        if (!checked) {
+            stand_pat = static_eval(pos);
+            if (stand_pat >= beta) return stand_pat;
+            alpha = std::max(alpha, stand_pat);
+        }
+
+        ScoredMoveList moves;
+        pos.generate_legal(moves.list, checked ? ALL_MOVES : CAPTURES);
+        if (checked && moves.empty()) return -MATE + ply;
+        score_moves(w, moves, Move(), ply);
+
+        const Board& b = pos.get_board();
+        int best = stand_pat;
+        while (Move m = moves.pick()) {
+            if (!checked) {
+                int gain = m.is_ep() ? PIECE_VALUE[PAWN] : PIECE_VALUE[type_of(b.squares[m.to()])];
+                if (m.is_promotion()) gain += PIECE_VALUE[m.promotion_type()] - PIECE_VALUE[PAWN];
+                if (stand_pat + gain + DELTA_MARGIN <= alpha) continue;
+                if (!m.is_promotion() && see(b, m) < 0) continue;
+            }
+            pos.make_move(m);
+            int sc = -qsearch(w, ply+1, -beta, -alpha);
+            pos.unmake_move(m);
+            if (w.stopped) return 0;
+            if (sc > best) {
+                best = sc;
+                alpha = std::max(alpha, sc);
+                if (alpha >= beta) break;
             }
-            return best;
         }
+        return best;
     }
 
-    std::string select_move(const Game& g0) override {
-        Game root = g0; // need non-const for legal_moves()
-        auto moves = root.legal_moves();
-        if (moves.empty()) return "";
+    // Negamax principal variation search; scores are from the side to
+    // move's view. The first move gets the full (alpha, beta) window, the
+    // rest a null window that only proves them no better, re-searched in
+    // full when that proof fails. Only null-window nodes take TT cutoffs,
+    // so the PV collected in the worker's table is never cut short.
+    int search(SearchWorker& w, int depth, int ply, int alpha, int beta, bool can_null = true) {
+        if (depth <= 0) return qsearch(w, ply, alpha, beta);
+
+        // Poll every 1024 nodes; an aborted subtree's value is discarded.
+        if ((w.count_node() & 1023) == 0 && should_stop()) w.stopped = true;
+        if (w.stopped) return 0;
+
+        Game& pos = w.pos;
+        w.pv_len[ply] = 0;
+        if (pos.is_repetition(ply) || pos.is_fifty_move_draw()) return 0;
+        if (ply >= SearchWorker::MAX_PLY - 1) return static_eval(pos);
+
+        bool pv_node = beta - alpha > 1;
+        TTEntry e;
+        bool hit = tt.probe(pos.hash(), e);
+        if (hit && !pv_node && e.depth >= depth) {
+            int s = score_from_tt(e.score, ply);
+            if (e.bound == BOUND_EXACT ||
+                (e.bound == BOUND_LOWER && s >= beta) ||
+                (e.bound == BOUND_UPPER && s <= alpha))
+                return s;
+        }
 
-        int bestScore = (g0.side_to_move()==Color::White ? -1000000000 : +1000000000);
-        std::string best = moves.front();
+        // Selectivity, only where a null window is searched and the side to
+        // move isn't in check: a static evaluation far above beta (reverse
+        // futility), or a reduced search that still beats beta after
+        // passing the move (null move), stands in for the real search. The
+        // null move is skipped right after another one and without pieces,
+        // where zugzwang makes passing better than any real move.
+        bool checked = pos.in_check();
+        int eval = -INF;
+        if (!pv_node && !checked) {
+            eval = static_eval(pos);
+            if (depth <= params.rfp_depth && !is_mate_score(beta)
+                && eval - params.rfp_margin * depth >= beta)
+                return eval;
+
+            const Board& b = pos.get_board();
+            Color us = pos.side_to_move();
+            bool has_pieces = b.occ[int(us)] & ~(b.pieces_of(us, PAWN) | b.pieces_of(us, KING));
+            if (can_null && has_pieces && depth >= params.null_move_depth && eval >= beta) {
+                int r = params.null_move_reduction + depth / 6;
+                pos.make_null_move();
+                int sc = -search(w, depth-1-r, ply+1, -beta, -beta+1, false);
+                pos.unmake_null_move();
+                if (w.stopped) return 0;
+                if (sc >= beta) return is_mate_score(sc) ? beta : sc;
+            }
+        }
+        // Quiet moves can't lift a hopeless static score to alpha near the leaves.
+        bool futile = eval != -INF && depth <= params.futility_depth && !is_mate_score(alpha)
+                   && eval + params.futility_margin * depth <= alpha;
+
+        ScoredMoveList moves;
+        pos.generate_legal(moves.list);
+        if (moves.empty())
+            return checked ? -MATE + ply : 0; // mated or stalemate
+        score_moves(w, moves, hit ? e.move : Move(), ply);
+
+        int alpha0 = alpha;
+        int best = -INF;
+        Move bestMove;
+        while (Move m = moves.pick()) {
+            bool quiet = !m.is_capture() && !m.is_promotion();
+            pos.make_move(m);
+            bool gives_check = pos.in_check();
+            int n = moves.picked();
+            if (futile && quiet && n > 1 && !gives_check) {
+                pos.unmake_move(m);
+                continue;
+            }
 
-        for (auto& m : moves) {
-            Game child = g0; std::string err;
-            if (!child.move(m, err)) continue;
-            int sc = search(child, max_depth-1, -1000000000, +1000000000);
-            if (g0.side_to_move()==Color::White) {
-                if (sc > bestScore) { bestScore = sc; best = m; }
+            // Late quiet moves are searched shallower first and only get
+            // their full depth back if they beat alpha after all.
+            int sc;
+            if (n == 1) {
+                sc = -search(w, depth-1, ply+1, -beta, -alpha);
             } else {
-                if (sc < bestScore) { bestScore = sc; best = m; }
+                int r = 0;
+                if (quiet && !checked && !gives_check && depth >= params.lmr_depth && n > params.lmr_moves)
+                    r = std::clamp(reductions[std::min(depth, 63)][std::min(n, 63)] - pv_node, 0, depth - 2);
+                sc = -search(w, depth-1-r, ply+1, -alpha-1, -alpha);
+                if (r > 0 && sc > alpha)
+                    sc = -search(w, depth-1, ply+1, -alpha-1, -alpha);
+                if (sc > alpha && sc < beta)
+                    sc = -search(w, depth-1, ply+1, -beta, -alpha);
             }
+            pos.unmake_move(m);
+            if (w.stopped) return 0;
+
+            if (sc > best) {
+                best = sc;
+                bestMove = m;
+                if (sc > alpha) {
+                    alpha = sc;
+                    w.update_pv(ply, m);
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+
+        if (alpha >= beta) {
+            ++w.fail_high;
+            if (moves.picked() == 1) ++w.fail_high_first;
+            update_quiet_stats(w, bestMove, depth, ply);
         }
+
+        Bound bound = best >= beta ? BOUND_LOWER : best > alpha0 ? BOUND_EXACT : BOUND_UPPER;
+        tt.store(pos.hash(), bestMove, score_to_tt(best, ply), depth, bound);
         return best;
     }
+
+    // The root as a PVS node over 'moves', the previous best first. Sets
+    // 'best' when a move beats alpha and returns the fail-soft score, or
+    // returns false if the iteration was cut short.
+    bool search_root(SearchWorker& w, MoveList& moves, int depth, int alpha, int beta,
+                     Move& best, int& score) {
+        std::swap(moves.moves[0], *std::find(moves.moves, moves.moves + moves.count, best));
+
+        w.pv_len[0] = 0;
+        int bestScore = -INF;
+        for (int i = 0; i < moves.count; ++i) {
+            Move m = moves.moves[i];
+            w.pos.make_move(m);
+            int sc;
+            if (i == 0) {
+                sc = -search(w, depth-1, 1, -beta, -alpha);
+            } else {
+                sc = -search(w, depth-1, 1, -alpha-1, -alpha);
+                if (sc > alpha && sc < beta)
+                    sc = -search(w, depth-1, 1, -beta, -alpha);
+            }
+            w.pos.unmake_move(m);
+            if (w.stopped) return false;
+
+            if (sc > bestScore) {
+                bestScore = sc;
+                if (sc > alpha) {
+                    alpha = sc;
+                    best = m;
+                    w.update_pv(0, m);
+                    if (alpha >= beta) break;
+                }
+            }
+        }
+        score = bestScore;
+        return true;
+    }
+
+    // One iteration inside an aspiration window around the previous
+    // iteration's score. A result outside the window only bounds the true
+    // score, so the window is widened on that side and the depth searched
+    // again; a fail high keeps the move that caused it.
+    bool search_iteration(SearchWorker& w, MoveList& moves, int depth, Move& best, int& score) {
+        int delta = ASPIRATION_WINDOW;
+        int alpha = -INF, beta = INF;
+        if (depth >= 4 && !is_mate_score(score)) {
+            alpha = score - delta;
+            beta = score + delta;
+        }
+        while (true) {
+            int sc;
+            if (!search_root(w, moves, depth, alpha, beta, best, sc)) return false;
+            if (sc <= alpha)     alpha = std::max(sc - delta, -INF);
+            else if (sc >= beta) beta = std::min(sc + delta, INF);
+            else { score = sc; return true; }
+            delta *= 2;
+            if (delta > 4 * PIECE_VALUE[QUEEN]) alpha = -INF, beta = INF;
+        }
+    }
+
+    // Lazy SMP helper: deepens on its own copy of the root until the main
+    // thread finishes. Odd helpers run one ply ahead so the threads spread
+    // over neighbouring depths and fill the shared table for each other.
+    void helper_loop(SearchWorker& w, MoveList moves) {
+        Move best = moves.moves[0];
+        int score = 0;
+        for (int depth = 1 + (w.id & 1); depth <= MAX_DEPTH; ++depth)
+            if (!search_iteration(w, moves, depth, best, score)) break;
+    }
+
+    // Share of fail-high nodes whose first move already cut off; a
+    // measure of move ordering quality (1.0 is perfect).
+    double first_move_cutoff_rate() const {
+        return fail_high ? double(fail_high_first) / double(fail_high) : 0.0;
+    }
+
+    // Iterative deepening: each completed depth replaces the best move; an
+    // iteration cut short by the clock is thrown away. Only the main thread
+    // reports, decides when to stop, and picks the move.
+    Move select_move(const Game& g0) override {
+        nodes = qnodes = fail_high = fail_high_first = 0;
+        MoveList moves = g0.legal_moves();
+        if (moves.empty()) { root_pv.clear(); return Move(); }
+
+        tt.new_search();
+        timer.init(limits, g0.side_to_move());
+        for (int d = 1; d < 64; ++d)
+            for (int n = 1; n < 64; ++n)
+                reductions[d][n] = int(params.lmr_base / 100.0
+                                       + std::log(d) * std::log(n) * 100.0 / params.lmr_divisor);
+
+        int depth_limit = limits.depth > 0 ? std::min(limits.depth, MAX_DEPTH)
+                        : (timer.has_budget() || limits.infinite) ? MAX_DEPTH
+                        : max_depth;
+
+        std::vector<std::unique_ptr<SearchWorker>> workers;
+        for (int i = 0; i < std::max(threads, 1); ++i) {
+            workers.push_back(std::make_unique<SearchWorker>());
+            workers.back()->pos = g0;
+            workers.back()->pos.set_network(network);
+            workers.back()->id = i;
+        }
+        auto total = [&](std::atomic<std::uint64_t> SearchWorker::*counter) {
+            std::uint64_t n = 0;
+            for (auto& w : workers) n += ((*w).*counter).load(std::memory_order_relaxed);
+            return n;
+        };
+
+        std::vector<std::thread> helpers;
+        for (std::size_t i = 1; i < workers.size(); ++i)
+            helpers.emplace_back([this, &w = *workers[i], moves] { helper_loop(w, moves); });
+
+        SearchWorker& main = *workers[0];
+        Move best = moves.moves[0];
+        int score = 0;
+        root_pv.assign(1, best);
+
+        for (int depth = 1; depth <= depth_limit; ++depth) {
+            if (depth > 1 && stop_requested.load(std::memory_order_relaxed)) break;
+
+            Move iterBest = best;
+            if (!search_iteration(main, moves, depth, iterBest, score)) break;
+            best = iterBest;
+
+            tt.store(g0.hash(), best, score, depth, BOUND_EXACT);
+            root_pv.assign(main.pv[0], main.pv[0] + main.pv_len[0]);
+            if (root_pv.empty() || root_pv[0] != best) root_pv.assign(1, best);
+            if (on_iteration) {
+                SearchInfo info;
+                info.depth = depth;
+                info.score = score;
+                info.nodes = total(&SearchWorker::nodes);
+                info.qnodes = total(&SearchWorker::qnodes);
+                info.time_ms = timer.elapsed_ms();
+                info.hashfull = tt.hashfull();
+                info.pv = root_pv;
+                on_iteration(info);
+            }
+            if (!pondering.load(std::memory_order_acquire) && timer.stop_deepening()) break;
+        }
+
+        helpers_stop = true;
+        for (auto& t : helpers) t.join();
+        helpers_stop = false;
+        nodes = total(&SearchWorker::nodes);
+        qnodes = total(&SearchWorker::qnodes);
+        for (auto& w : workers) { fail_high += w->fail_high; fail_high_first += w->fail_high_first; }
+        return best;
+    }
+};
+
+// ==================== Opening book (Polyglot) ====================
+// Reads Polyglot .bin books: 16-byte big-endian entries (key, move,
+// weight, learn) sorted by key, so a position's moves are one contiguous
+// run found by binary search. The file is memory-mapped where the OS
+// allows, so opening even a large book costs nothing up front.
+
+// Polyglot hashes positions with its own fixed Zobrist table ("Random64",
+// 781 numbers: 768 piece/square, 4 castling, 8 en passant file, 1 side).
+// Books only match with exactly these values, copied from the format
+// description; the tests check them against its reference keys.
+inline constexpr std::uint64_t POLYGLOT_RANDOM[781] = {
+    0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+    0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+    0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+    0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+    0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+    0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+    0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+    0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+    0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+    0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+    0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+    0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+    0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+    0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+    0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+    0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+    0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+    0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+    0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+    0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+    0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+    0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+    0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+    0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+    0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+    0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+    0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+    0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+    0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+    0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+    0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+    0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+    0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+    0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+    0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+    0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+    0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+    0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+    0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+    0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+    0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+    0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+    0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+    0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+    0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+    0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+    0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+    0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+    0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+    0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+    0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+    0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+    0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+    0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+    0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+    0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+    0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+    0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+    0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+    0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+    0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+    0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+    0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+    0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+    0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+    0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+    0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+    0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+    0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+    0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+    0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+    0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+    0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+    0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+    0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+    0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+    0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+    0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+    0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+    0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+    0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+    0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+    0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+    0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+    0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+    0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+    0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+    0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+    0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+    0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+    0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+    0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+    0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+    0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+    0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+    0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+    0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+    0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+    0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+    0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+    0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+    0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+    0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+    0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+    0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+    0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+    0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+    0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+    0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+    0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+    0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+    0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+    0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+    0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+    0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+    0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+    0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+    0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+    0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+    0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+    0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+    0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+    0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+    0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+    0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+    0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+    0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+    0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+    0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+    0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+    0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+    0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+    0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+    0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+    0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+    0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+    0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+    0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+    0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+    0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x1B6BACA2AE4E125BULL, 0x758F450C88572E0BULL,
+    0x959F587D507A8359ULL, 0xB063E962E045F54DULL, 0x60E8ED72C0DFF5D1ULL, 0x7B64978555326F9FULL,
+    0xFD080D236DA814BAULL, 0x8C90FD9B083F4558ULL, 0x106F72FE81E2C590ULL, 0x7976033A39F7D952ULL,
+    0xA4EC0132764CA04BULL, 0x733EA705FAE4FA77ULL, 0xB4D8F77BC3E56167ULL, 0x9E21F4F903B33FD9ULL,
+    0x9D765E419FB69F6DULL, 0xD30C088BA61EA5EFULL, 0x5D94337FBFAF7F5BULL, 0x1A4E4822EB4D7A59ULL,
+    0x6FFE73E81B637FB3ULL, 0xDDF957BC36D8B9CAULL, 0x64D0E29EEA8838B3ULL, 0x08DD9BDFD96B9F63ULL,
+    0x087E79E5A57D1D13ULL, 0xE328E230E3E2B3FBULL, 0x1C2559E30F0946BEULL, 0x720BF5F26F4D2EAAULL,
+    0xB0774D261CC609DBULL, 0x443F64EC5A371195ULL, 0x4112CF68649A260EULL, 0xD813F2FAB7F5C5CAULL,
+    0x660D3257380841EEULL, 0x59AC2C7873F910A3ULL, 0xE846963877671A17ULL, 0x93B633ABFA3469F8ULL,
+    0xC0C0F5A60EF4CDCFULL, 0xCAF21ECD4377B28CULL, 0x57277707199B8175ULL, 0x506C11B9D90E8B1DULL,
+    0xD83CC2687A19255FULL, 0x4A29C6465A314CD1ULL, 0xED2DF21216235097ULL, 0xB5635C95FF7296E2ULL,
+    0x22AF003AB672E811ULL, 0x52E762596BF68235ULL, 0x9AEBA33AC6ECC6B0ULL, 0x944F6DE09134DFB6ULL,
+    0x6C47BEC883A7DE39ULL, 0x6AD047C430A12104ULL, 0xA5B1CFDBA0AB4067ULL, 0x7C45D833AFF07862ULL,
+    0x5092EF950A16DA0BULL, 0x9338E69C052B8E7BULL, 0x455A4B4CFE30E3F5ULL, 0x6B02E63195AD0CF8ULL,
+    0x6B17B224BAD6BF27ULL, 0xD1E0CCD25BB9C169ULL, 0xDE0C89A556B9AE70ULL, 0x50065E535A213CF6ULL,
+    0x9C1169FA2777B874ULL, 0x78EDEFD694AF1EEDULL, 0x6DC93D9526A50E68ULL, 0xEE97F453F06791EDULL,
+    0x32AB0EDB696703D3ULL, 0x3A6853C7E70757A7ULL, 0x31865CED6120F37DULL, 0x67FEF95D92607890ULL,
+    0x1F2B1D1F15F6DC9CULL, 0xB69E38A8965C6B65ULL, 0xAA9119FF184CCCF4ULL, 0xF43C732873F24C13ULL,
+    0xFB4A3D794A9A80D2ULL, 0x3550C2321FD6109CULL, 0x371F77E76BB8417EULL, 0x6BFA9AAE5EC05779ULL,
+    0xCD04F3FF001A4778ULL, 0xE3273522064480CAULL, 0x9F91508BFFCFC14AULL, 0x049A7F41061A9E60ULL,
+    0xFCB6BE43A9F2FE9BULL, 0x08DE8A1C7797DA9BULL, 0x8F9887E6078735A1ULL, 0xB5B4071DBFC73A66ULL,
+    0x230E343DFBA08D33ULL, 0x43ED7F5A0FAE657DULL, 0x3A88A0FBBCB05C63ULL, 0x21874B8B4D2DBC4FULL,
+    0x1BDEA12E35F6A8C9ULL, 0x53C065C6C8E63528ULL, 0xE34A1D250E7A8D6BULL, 0xD6B04D3B7651DD7EULL,
+    0x5E90277E7CB39E2DULL, 0x2C046F22062DC67DULL, 0xB10BB459132D0A26ULL, 0x3FA9DDFB67E2F199ULL,
+    0x0E09B88E1914F7AFULL, 0x10E8B35AF3EEAB37ULL, 0x9EEDECA8E272B933ULL, 0xD4C718BC4AE8AE5FULL,
+    0x81536D601170FC20ULL, 0x91B534F885818A06ULL, 0xEC8177F83F900978ULL, 0x190E714FADA5156EULL,
+    0xB592BF39B0364963ULL, 0x89C350C893AE7DC1ULL, 0xAC042E70F8B383F2ULL, 0xB49B52E587A1EE60ULL,
+    0xFB152FE3FF26DA89ULL, 0x3E666E6F69AE2C15ULL, 0x3B544EBE544C19F9ULL, 0xE805A1E290CF2456ULL,
+    0x24B33C9D7ED25117ULL, 0xE74733427B72F0C1ULL, 0x0A804D18B7097475ULL, 0x57E3306D881EDB4FULL,
+    0x4AE7D6A36EB5DBCBULL, 0x2D8D5432157064C8ULL, 0xD1E649DE1E7F268BULL, 0x8A328A1CEDFE552CULL,
+    0x07A3AEC79624C7DAULL, 0x84547DDC3E203C94ULL, 0x990A98FD5071D263ULL, 0x1A4FF12616EEFC89ULL,
+    0xF6F7FD1431714200ULL, 0x30C05B1BA332F41CULL, 0x8D2636B81555A786ULL, 0x46C9FEB55D120902ULL,
+    0xCCEC0A73B49C9921ULL, 0x4E9D2827355FC492ULL, 0x19EBB029435DCB0FULL, 0x4659D2B743848A2CULL,
+    0x963EF2C96B33BE31ULL, 0x74F85198B05A2E7DULL, 0x5A0F544DD2B1FB18ULL, 0x03727073C2E134B1ULL,
+    0xC7F6AA2DE59AEA61ULL, 0x352787BAA0D7C22FULL, 0x9853EAB63B5E0B35ULL, 0xABBDCDD7ED5C0860ULL,
+    0xCF05DAF5AC8D77B0ULL, 0x49CAD48CEBF4A71EULL, 0x7A4C10EC2158C4A6ULL, 0xD9E92AA246BF719EULL,
+    0x13AE978D09FE5557ULL, 0x730499AF921549FFULL, 0x4E4B705B92903BA4ULL, 0xFF577222C14F0A3AULL,
+    0x55B6344CF97AAFAEULL, 0xB862225B055B6960ULL, 0xCAC09AFBDDD2CDB4ULL, 0xDAF8E9829FE96B5FULL,
+    0xB5FDFC5D3132C498ULL, 0x310CB380DB6F7503ULL, 0xE87FBB46217A360EULL, 0x2102AE466EBB1148ULL,
+    0xF8549E1A3AA5E00DULL, 0x07A69AFDCC42261AULL, 0xC4C118BFE78FEAAEULL, 0xF9F4892ED96BD438ULL,
+    0x1AF3DBE25D8F45DAULL, 0xF5B4B0B0D2DEEEB4ULL, 0x962ACEEFA82E1C84ULL, 0x046E3ECAAF453CE9ULL,
+    0xF05D129681949A4CULL, 0x964781CE734B3C84ULL, 0x9C2ED44081CE5FBDULL, 0x522E23F3925E319EULL,
+    0x177E00F9FC32F791ULL, 0x2BC60A63A6F3B3F2ULL, 0x222BBFAE61725606ULL, 0x486289DDCC3D6780ULL,
+    0x7DC7785B8EFDFC80ULL, 0x8AF38731C02BA980ULL, 0x1FAB64EA29A2DDF7ULL, 0xE4D9429322CD065AULL,
+    0x9DA058C67844F20CULL, 0x24C0E332B70019B0ULL, 0x233003B5A6CFE6ADULL, 0xD586BD01C5C217F6ULL,
+    0x5E5637885F29BC2BULL, 0x7EBA726D8C94094BULL, 0x0A56A5F0BFE39272ULL, 0xD79476A84EE20D06ULL,
+    0x9E4C1269BAA4BF37ULL, 0x17EFEE45B0DEE640ULL, 0x1D95B0A5FCF90BC6ULL, 0x93CBE0B699C2585DULL,
+    0x65FA4F227A2B6D79ULL, 0xD5F9E858292504D5ULL, 0xC2B5A03F71471A6FULL, 0x59300222B4561E00ULL,
+    0xCE2F8642CA0712DCULL, 0x7CA9723FBB2E8988ULL, 0x2785338347F2BA08ULL, 0xC61BB3A141E50E8CULL,
+    0x150F361DAB9DEC26ULL, 0x9F6A419D382595F4ULL, 0x64A53DC924FE7AC9ULL, 0x142DE49FFF7A7C3DULL,
+    0x0C335248857FA9E7ULL, 0x0A9C32D5EAE45305ULL, 0xE6C42178C4BBB92EULL, 0x71F1CE2490D20B07ULL,
+    0xF1BCC3D275AFE51AULL, 0xE728E8C83C334074ULL, 0x96FBF83A12884624ULL, 0x81A1549FD6573DA5ULL,
+    0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+    0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A0ULL, 0x1EF6E6DBB1961EC9ULL,
+    0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+    0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+    0xF8D626AAAF278509ULL
+};
+
+std::uint64_t polyglot_key(const Game& g) {
+    const Board& b = g.get_board();
+    std::uint64_t k = 0;
+    for (int pc = 0; pc < 12; ++pc) {
+        // Polyglot's piece kinds run black pawn, white pawn, black knight, ...
+        int kind = 2 * type_of(pc) + (color_of(pc) == Color::White ? 1 : 0);
+        Bitboard bb = b.pieces[pc];
+        while (bb) k ^= POLYGLOT_RANDOM[64 * kind + pop_lsb(bb)];
+    }
+    int cr = g.castling_rights();
+    if (cr & WHITE_OO)  k ^= POLYGLOT_RANDOM[768];
+    if (cr & WHITE_OOO) k ^= POLYGLOT_RANDOM[769];
+    if (cr & BLACK_OO)  k ^= POLYGLOT_RANDOM[770];
+    if (cr & BLACK_OOO) k ^= POLYGLOT_RANDOM[771];
+    // Like Polyglot, the EP file only counts when a pawn can take there;
+    // Game already drops the square otherwise.
+    if (g.ep_square() >= 0) k ^= POLYGLOT_RANDOM[772 + col_of(g.ep_square())];
+    if (g.side_to_move() == Color::White) k ^= POLYGLOT_RANDOM[780];
+    return k;
+}
+
+struct BookEntry {
+    std::uint64_t key = 0;
+    std::uint16_t move = 0;   // to file:3, to row:3, from file:3, from row:3, promotion:3
+    std::uint16_t weight = 0;
+    std::uint32_t learn = 0;
+};
+
+class PolyglotBook {
+    static constexpr std::size_t ENTRY_SIZE = 16;
+
+    const unsigned char* data = nullptr;
+    std::size_t count = 0;              // entries
+    std::size_t mapped_bytes = 0;       // 0 when 'data' points into 'buffer'
+    std::vector<unsigned char> buffer;  // fallback without mmap
+
+    static std::uint64_t read_be(const unsigned char* p, int bytes) {
+        std::uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v = (v << 8) | p[i];
+        return v;
+    }
+
+    BookEntry entry(std::size_t i) const {
+        const unsigned char* p = data + i * ENTRY_SIZE;
+        return BookEntry{read_be(p, 8), std::uint16_t(read_be(p + 8, 2)),
+                         std::uint16_t(read_be(p + 10, 2)), std::uint32_t(read_be(p + 12, 4))};
+    }
+
+public:
+    PolyglotBook() = default;
+    PolyglotBook(const PolyglotBook&) = delete;
+    PolyglotBook& operator=(const PolyglotBook&) = delete;
+    ~PolyglotBook() { close(); }
+
+    bool is_open() const { return data != nullptr; }
+    std::size_t size() const { return count; }
+
+    bool open(const std::string& path, std::string& errmsg) {
+        close();
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) { errmsg = "cannot open " + path; return false; }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || st.st_size < off_t(ENTRY_SIZE)) {
+            ::close(fd);
+            errmsg = "empty or unreadable book " + path;
+            return false;
+        }
+        void* p = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (p == MAP_FAILED) { errmsg = "cannot map " + path; return false; }
+        data = static_cast<const unsigned char*>(p);
+        mapped_bytes = std::size_t(st.st_size);
+        count = mapped_bytes / ENTRY_SIZE;
+#else
+        std::ifstream in(path, std::ios::binary);
+        if (!in) { errmsg = "cannot open " + path; return false; }
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        if (buffer.size() < ENTRY_SIZE) { buffer.clear(); errmsg = "empty book " + path; return false; }
+        data = buffer.data();
+        count = buffer.size() / ENTRY_SIZE;
+#endif
+        return true;
+    }
+
+    void close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (mapped_bytes) ::munmap(const_cast<unsigned char*>(data), mapped_bytes);
+#endif
+        data = nullptr;
+        count = mapped_bytes = 0;
+        buffer.clear();
+    }
+
+    // Every entry for 'key', in file order.
+    std::vector<BookEntry> entries(std::uint64_t key) const {
+        std::size_t lo = 0, hi = count;
+        while (lo < hi) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (read_be(data + mid * ENTRY_SIZE, 8) < key) lo = mid + 1;
+            else hi = mid;
+        }
+        std::vector<BookEntry> out;
+        for (std::size_t i = lo; i < count && read_be(data + i * ENTRY_SIZE, 8) == key; ++i)
+            out.push_back(entry(i));
+        return out;
+    }
+
+    // The legal move a Polyglot move code stands for in 'g', or Move().
+    // Castling is stored as the king taking its own rook (e1h1).
+    static Move decode(const Game& g, std::uint16_t code) {
+        int to = to_sq((code >> 3) & 7, code & 7);
+        int from = to_sq((code >> 9) & 7, (code >> 6) & 7);
+        int promo = (code >> 12) & 7;
+        if (promo > 4) return Move();
+        const Board& b = g.get_board();
+        if (type_of(b.squares[from]) == KING && b.squares[to] == make_piece(g.side_to_move(), ROOK))
+            to = col_of(to) == 7 ? from + 2 : from - 2;
+        return g.find_legal_move(from, to, promo ? " nbrq"[promo] : 'q');
+    }
+
+    // A book move for 'g': the heaviest one when 'best', otherwise one drawn
+    // with probability proportional to its weight using 'random'. Entries
+    // whose move isn't legal here (a key collision) are ignored.
+    Move probe(const Game& g, bool best, std::uint64_t random) const {
+        if (!is_open()) return Move();
+        std::vector<std::pair<Move, std::uint32_t>> moves;
+        std::uint64_t total = 0;
+        for (const BookEntry& e : entries(polyglot_key(g))) {
+            Move m = decode(g, e.move);
+            if (!m || e.weight == 0) continue;
+            moves.emplace_back(m, e.weight);
+            total += e.weight;
+        }
+        if (moves.empty()) return Move();
+        if (best)
+            return std::max_element(moves.begin(), moves.end(),
+                                    [](auto& a, auto& b) { return a.second < b.second; })->first;
+        std::uint64_t pick = random % total;
+        for (auto& [m, w] : moves) {
+            if (pick < w) return m;
+            pick -= w;
+        }
+        return moves.back().first;
+    }
 };
 
 // --------- Game::loop_with_strategies (after Strategy defined) ---------
@@ -847,27 +3046,31 @@ void Game::loop_with_strategies(Strategy* white, Strategy* black) {
         b.display_board();
 
         Strategy* who = (turn==Color::White ? white : black);
-        std::string line;
         if (who) {
-            line = who->select_move(*this);
-            if (line.empty()) { std::cout << to_cstr(turn) << " has no move.\n"; break; }
-            std::cout << "> " << line << "\n";
+            Move m = who->select_move(*this);
+            if (!m) { std::cout << to_cstr(turn) << " has no move.\n"; break; }
+            std::cout << "> " << to_string(m) << "\n";
+            make_move(m);
         } else {
             std::cout << "Enter move (e.g., 10 30): ";
+            std::string line;
             if (!std::getline(std::cin, line)) break;
             if (line=="quit" || line=="exit") break;
-        }
 
-        std::string err;
-        if (!move(line, err)) { std::cout << "Invalid: " << err << "\n"; continue; }
+            std::string err;
+            if (!move(line, err)) { std::cout << "Invalid: " << err << "\n"; continue; }
+        }
 
         if (is_checkmate(turn)) { b.display_board(); std::cout << "Checkmate! " << to_cstr(other(turn)) << " wins.\n"; break; }
         if (is_stalemate(turn)) { b.display_board(); std::cout << "Stalemate! Draw.\n"; break; }
+        if (is_repetition())    { b.display_board(); std::cout << "Threefold repetition! Draw.\n"; break; }
+        if (is_fifty_move_draw()) { b.display_board(); std::cout << "Fifty-move rule! Draw.\n"; break; }
         if (in_check(turn))     { std::cout << "Check on " << to_cstr(turn) << "!\n"; }
     }
 }
 
 // ==================== main ====================
+#ifndef CHESS_NO_MAIN
 int main() {
     Game game;
 
@@ -920,5 +3123,4 @@ int main() {
     game.loop_with_strategies(white, black);
     return 0;
 }
-
-
+#endif // CHESS_NO_MAIN
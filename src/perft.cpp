@@ -1,60 +1,194 @@
 // perft.cpp (portable)
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #define CHESS_NO_MAIN
 #include "minimax.cpp"
 
-// Parse "rc rc" (e.g., "61 71") into coordinates
-static inline bool parse_rc_move(const std::string& m, int& r0,int& c0,int& r1,int& c1){
-    if (m.size() < 5) return false;
-    r0 = m[0]-'0'; c0 = m[1]-'0';
-    r1 = m[3]-'0'; c1 = m[4]-'0';
-    return (r0>=0 && r0<8 && c0>=0 && c0<8 && r1>=0 && r1<8 && c1>=0 && c1<8);
-}
+// Subtree counts keyed by (position hash, depth), so transpositions are
+// counted once. Lockless like the search's table: a slot holds key ^ data
+// next to data, and a slot torn by two threads writing at once fails the
+// check instead of handing back a wrong count.
+struct PerftCache {
+    struct Slot {
+        std::atomic<uint64_t> key_xor_data{0};
+        std::atomic<uint64_t> data{0};    // count << 8 | depth
+    };
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
 
-// Perft that expands promotions into 4 branches (Q,R,B,N)
-static uint64_t perft(Game& g, int depth) {
-    if (depth == 0) return 1ULL;
+    // 0 MB disables the cache.
+    void resize(size_t mb) {
+        slots.reset();
+        mask = 0;
+        if (mb == 0) return;
+        size_t n = 1;
+        while (n * 2 * sizeof(Slot) <= (mb << 20)) n *= 2;
+        slots = std::make_unique<Slot[]>(n);
+        mask = n - 1;
+    }
+    bool enabled() const { return slots != nullptr; }
+    size_t size_bytes() const { return slots ? (mask + 1) * sizeof(Slot) : 0; }
 
-    uint64_t nodes = 0;
-    auto moves = g.legal_moves();
-
-    for (const auto& m : moves) {
-        // Detect if this move is a promotion (pawn reaching rank 0 or 7)
-        int r0,c0,r1,c1;
-        bool promo4 = false;
-        if (parse_rc_move(m, r0,c0,r1,c1)) {
-            const Piece* p0 = g.get_board().board[r0][c0].get();
-            if (p0 && dynamic_cast<const Pawn*>(p0) != nullptr && (r1 == 0 || r1 == 7)) {
-                promo4 = true; // your engine auto-queens, but perft needs 4 outcomes
-            }
-        }
+    bool probe(uint64_t key, int depth, uint64_t& count) const {
+        const Slot& s = slots[(key ^ uint64_t(depth)) & mask];
+        uint64_t d = s.data.load(std::memory_order_relaxed);
+        if ((s.key_xor_data.load(std::memory_order_relaxed) ^ d) != key || int(d & 0xFF) != depth)
+            return false;
+        count = d >> 8;
+        return true;
+    }
+    void store(uint64_t key, int depth, uint64_t count) {
+        Slot& s = slots[(key ^ uint64_t(depth)) & mask];
+        uint64_t d = (count << 8) | uint64_t(depth);
+        s.key_xor_data.store(key ^ d, std::memory_order_relaxed);
+        s.data.store(d, std::memory_order_relaxed);
+    }
+};
+static PerftCache cache;
 
-        Game child = g;
-        std::string err;
-        if (!child.move(m, err)) continue;
+struct PerftStats {
+    uint64_t probes = 0, hits = 0;
+};
+
+// perft() from minimax.cpp with the subtree cache in front, when enabled.
+// Depth-1 subtrees are cheaper to recount than to look up.
+static uint64_t perft(Game& g, int depth, PerftStats& st) {
+    if (depth < 2 || !cache.enabled()) return perft(g, depth);
+
+    uint64_t nodes = 0;
+    ++st.probes;
+    if (cache.probe(g.hash(), depth, nodes)) { ++st.hits; return nodes; }
 
-        uint64_t sub = perft(child, depth - 1);
-        nodes += promo4 ? (sub * 4ULL) : sub;
+    MoveList moves;
+    g.generate_legal(moves);
+    for (Move m : moves) {
+        g.make_move(m);
+        nodes += perft(g, depth - 1, st);
+        g.unmake_move(m);
     }
+    cache.store(g.hash(), depth, nodes);
     return nodes;
 }
 
+// perft [--threads N] [--split D] [--divide] [--hash MB] [--deep]
+//       [--suite FILE.epd [--max-depth D]]
+struct PerftOptions {
+    int threads = 1;       // 0 on the command line: one per hardware thread
+    int split_depth = 1;   // plies expanded into independent tasks (1: root moves)
+    bool divide = false;   // print the count under each root move
+    size_t hash_mb = 0;    // perft cache budget; 0: off
+    bool deep = false;     // also run the d5/d6 reference counts
+    std::string suite;     // EPD file with ";D1 n ;D2 n ..." expectations
+    int max_depth = 4;     // deepest ";Dn" checked from the suite
+};
+static PerftOptions opts;
+
+struct PerftTask {
+    Game pos;
+    int root;              // index of the root move this subtree hangs off
+};
+
+static void collect_tasks(Game& g, int plies, int root, std::vector<PerftTask>& out) {
+    if (plies == 0) { out.push_back({g, root}); return; }
+    MoveList moves;
+    g.generate_legal(moves);
+    for (Move m : moves) {
+        g.make_move(m);
+        collect_tasks(g, plies - 1, root, out);
+        g.unmake_move(m);
+    }
+}
+
+// Splits the tree 'split_depth' plies down into tasks that a pool of threads
+// pulls from a shared counter, so a thread that finishes a small subtree
+// immediately takes the next one. Subtree counts are summed per root move.
+static uint64_t perft_parallel(Game& g, int depth, const PerftOptions& o, PerftStats& st) {
+    if (depth <= 0) return 1ULL;
+    MoveList roots;
+    g.generate_legal(roots);
+
+    int split = std::clamp(o.split_depth, 1, depth);
+    std::vector<PerftTask> tasks;
+    for (int i = 0; i < roots.count; ++i) {
+        g.make_move(roots.moves[i]);
+        collect_tasks(g, split - 1, i, tasks);
+        g.unmake_move(roots.moves[i]);
+    }
+
+    std::vector<std::atomic<uint64_t>> per_root(roots.count);
+    std::atomic<size_t> next{0};
+    std::atomic<uint64_t> probes{0}, hits{0};
+    auto work = [&] {
+        PerftStats mine;
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < tasks.size(); )
+            per_root[tasks[i].root].fetch_add(perft(tasks[i].pos, depth - split, mine), std::memory_order_relaxed);
+        probes += mine.probes;
+        hits += mine.hits;
+    };
+
+    std::vector<std::thread> pool;
+    for (int t = 1; t < o.threads; ++t) pool.emplace_back(work);
+    work();
+    for (auto& t : pool) t.join();
+    st.probes += probes;
+    st.hits += hits;
+
+    uint64_t total = 0;
+    for (int i = 0; i < roots.count; ++i) {
+        uint64_t n = per_root[i].load();
+        if (o.divide) std::cout << "  " << to_uci(roots.moves[i]) << ": " << n << "\n";
+        total += n;
+    }
+    return total;
+}
+
+static uint64_t count(Game& g, int d, PerftStats& st) {
+    return (opts.threads > 1 || opts.divide) ? perft_parallel(g, d, opts, st) : perft(g, d, st);
+}
+
+// After a mismatch: the count under each root move with the position it
+// leads to, ready to feed to a reference engine and bisect one ply deeper.
+static void divide_report(Game& g, int depth) {
+    MoveList moves;
+    g.generate_legal(moves);
+    PerftStats st;
+    for (Move m : moves) {
+        g.make_move(m);
+        uint64_t n = depth > 1 ? perft(g, depth - 1, st) : 1;
+        std::cerr << "  " << to_uci(m) << ": " << n << "    " << g.fen() << "\n";
+        g.unmake_move(m);
+    }
+}
+
 static void run(const std::string& name, Game& g, int d, uint64_t expected) {
     using namespace std::chrono;
     auto t0 = high_resolution_clock::now();
-    uint64_t n = perft(g, d);
+    PerftStats st;
+    uint64_t n = count(g, d, st);
     auto t1 = high_resolution_clock::now();
     double ms = duration<double, std::milli>(t1 - t0).count();
     double nps = (ms > 0) ? (n / (ms / 1000.0)) : 0.0;
     std::cout << name << " d=" << d << "  nodes=" << n
-              << "  time=" << ms << " ms  (" << (uint64_t)nps << " nps)\n";
+              << "  time=" << ms << " ms  (" << (uint64_t)nps << " nps)";
+    if (opts.threads > 1) std::cout << "  threads=" << opts.threads;
+    if (st.probes) {
+        char rate[16];
+        std::snprintf(rate, sizeof rate, "%.1f%%", 100.0 * st.hits / st.probes);
+        std::cout << "  hash hits=" << st.hits << "/" << st.probes << " (" << rate << ")";
+    }
+    std::cout << "\n";
     if (expected) {
         if (n != expected) {
             std::cerr << "MISMATCH: expected " << expected << "\n";
@@ -63,18 +197,101 @@ static void run(const std::string& name, Game& g, int d, uint64_t expected) {
     }
 }
 
-int main() {
+// Streams an EPD suite ("<fen> ;D1 20 ;D2 400 ..."), checking every listed
+// depth up to 'max_depth'. A position stops at its first wrong depth and
+// gets a divide report. Returns the process exit code.
+static int run_suite(const std::string& path, int max_depth) {
+    using namespace std::chrono;
+    std::ifstream in(path);
+    if (!in) { std::cerr << "cannot open " << path << "\n"; return 1; }
+
+    uint64_t total_nodes = 0;
+    double total_ms = 0;
+    int positions = 0, checks = 0, failures = 0, lineno = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        ++lineno;
+        if (line.find_first_not_of(" \t\r") == std::string::npos || line[0] == '#') continue;
+
+        size_t semi = line.find(';');
+        Game g;
+        std::string err;
+        if (!g.load_fen(line.substr(0, semi), err)) {
+            std::cerr << path << ":" << lineno << ": " << err << "\n";
+            ++failures;
+            continue;
+        }
+        ++positions;
+
+        std::istringstream fields(semi == std::string::npos ? "" : line.substr(semi));
+        std::string tok;
+        int deepest = 0;
+        bool ok = true;
+        while (ok && fields >> tok) {
+            uint64_t expected;
+            if (tok.size() < 3 || tok.compare(0, 2, ";D") != 0 || !(fields >> expected)) continue;
+            int d = std::atoi(tok.c_str() + 2);
+            if (d < 1 || d > max_depth) continue;
+
+            PerftStats st;
+            auto t0 = steady_clock::now();
+            uint64_t n = count(g, d, st);
+            total_ms += duration<double, std::milli>(steady_clock::now() - t0).count();
+            total_nodes += n;
+            ++checks;
+            deepest = d;
+            if (n != expected) {
+                std::cerr << "MISMATCH " << path << ":" << lineno << " d=" << d
+                          << " got " << n << " expected " << expected << "\n  " << g.fen() << "\n";
+                divide_report(g, d);
+                ++failures;
+                ok = false;
+            }
+        }
+        if (ok) std::cout << "ok  d1-" << deepest << "  " << line.substr(0, semi) << "\n";
+    }
+
+    double nps = total_ms > 0 ? total_nodes / (total_ms / 1000.0) : 0.0;
+    std::cout << "suite " << path << ": " << positions << " positions, " << checks << " counts, "
+              << failures << " failures, nodes=" << total_nodes << "  time=" << total_ms
+              << " ms  (" << (uint64_t)nps << " nps)\n";
+    return failures ? 2 : 0;
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if      (a == "--threads" && i + 1 < argc) opts.threads = std::max(0, std::atoi(argv[++i]));
+        else if (a == "--split"   && i + 1 < argc) opts.split_depth = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--divide")                  opts.divide = true;
+        else if (a == "--hash"    && i + 1 < argc) opts.hash_mb = std::strtoull(argv[++i], nullptr, 10);
+        else if (a == "--deep")                    opts.deep = true;
+        else if (a == "--suite"   && i + 1 < argc) opts.suite = argv[++i];
+        else if (a == "--max-depth" && i + 1 < argc) opts.max_depth = std::atoi(argv[++i]);
+        else {
+            std::cerr << "usage: perft [--threads N] [--split D] [--divide] [--hash MB] [--deep]\n"
+                         "             [--suite FILE.epd [--max-depth D]]\n";
+            return 1;
+        }
+    }
+    if (opts.threads == 0) opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    cache.resize(opts.hash_mb);
+    if (cache.enabled()) std::cout << "perft cache: " << (cache.size_bytes() >> 20) << " MB\n";
+    if (!opts.suite.empty()) return run_suite(opts.suite, opts.max_depth);
+
     // --- Startpos known perft (d1..d6) ---
     // 1: 20  2: 400  3: 8902  4: 197281  5: 4865609  6: 119060324
     {
         Game g;
-        g.load_startpos(); // default ctor may already do this
+        g.load_startpos();
         run("startpos", g, 1, 20);
         run("startpos", g, 2, 400);
         run("startpos", g, 3, 8902);
         run("startpos", g, 4, 197281);
-        // run("startpos", g, 5, 4865609);
-        // run("startpos", g, 6, 119060324); // slow; enable when you want
+        if (opts.deep) {
+            run("startpos", g, 5, 4865609);
+            run("startpos", g, 6, 119060324);
+        }
     }
 
     // --- Kiwipete known perft (d1..d6) ---
@@ -91,8 +308,10 @@ int main() {
         run("kiwipete", g, 2, 2039);
         run("kiwipete", g, 3, 97862);
         run("kiwipete", g, 4, 4085603);
-        // run("kiwipete", g, 5, 193690690);
-        // run("kiwipete", g, 6, 8031647685ULL);
+        if (opts.deep) {
+            run("kiwipete", g, 5, 193690690);
+            run("kiwipete", g, 6, 8031647685ULL); // use --hash (and --threads) for this one
+        }
     }
 
     return 0;
@@ -1,9 +1,11 @@
 // test_chess.cpp
 #include <cassert>
+#include <cstring>
 #include <string>
 #include <iostream>
 
 #define CHESS_NO_MAIN
+#define CHESS_HASH_DEBUG   // every make/unmake re-derives the Zobrist key
 #include "minimax.cpp"
 
 // ---------- helpers ----------
@@ -20,10 +22,7 @@ static bool do_bad(Game& g, const std::string& mv) {
     return !ok;
 }
 static char at(const Game& g, int r, int c) {
-    const Board& b = g.get_board();
-    const Piece* p = b.board[r][c].get();
-    if (!p) return '-';
-    return p->display().empty() ? '?' : p->display()[0];
+    return g.get_board().piece_char(r, c);
 }
 static Color turn(const Game& g) { return g.side_to_move(); }
 static std::string col(Color c){ return c==Color::White?"White":c==Color::Black?"Black":"None"; }
@@ -145,6 +144,698 @@ void test_legal_moves_nonempty_start() {
     // We won't assert exact move text; engines can vary. Just ensure non-empty.
 }
 
+void test_staged_generation() {
+    Game g;
+    assert(do_ok(g, "14 34")); // e2e4
+    assert(do_ok(g, "63 43")); // d7d5: exd5 is now available
+
+    MoveList caps, quiets, all;
+    g.generate_legal(caps, CAPTURES);
+    g.generate_legal(quiets, QUIETS);
+    g.generate_legal(all);
+    assert(caps.size() == 1);
+    assert(caps.size() + quiets.size() == all.size());
+    // Captures come first in the combined list
+    assert(all.moves[0] == caps.moves[0]);
+}
+
+void test_check_evasions_only() {
+    Game g;
+    assert(do_ok(g, "14 34")); // e2e4
+    assert(do_ok(g, "65 55")); // f7f6
+    assert(do_ok(g, "03 47")); // Qd1h5+
+    MoveList lm = g.legal_moves();
+    assert(lm.size() == 1 && to_string(lm.moves[0]) == "66 56"); // g7g6 is the only reply
+}
+
+void test_move_encoding() {
+    Move m(to_sq(1,4), to_sq(3,4), Move::DOUBLE_PUSH);
+    assert(m.from() == 12 && m.to() == 28 && m.is_double_push());
+    assert(!m.is_capture() && !m.is_promotion() && !m.is_castle());
+
+    Move p = Move::promotion(to_sq(6,0), to_sq(7,1), KNIGHT, true);
+    assert(p.is_capture() && p.is_promotion() && p.promotion_type() == KNIGHT);
+    assert(to_string(p) == "60 71n");
+    assert(!Move() && m);
+}
+
+void test_underpromotion() {
+    Game g;
+    // March the h-pawn up and take on g7, then promote on g8/h8
+    assert(do_ok(g, "17 37")); assert(do_ok(g, "60 50")); // h4 a6
+    assert(do_ok(g, "37 47")); assert(do_ok(g, "50 40")); // h5 a5
+    assert(do_ok(g, "47 57")); assert(do_ok(g, "40 30")); // h6 a4
+    assert(do_ok(g, "57 66")); assert(do_ok(g, "30 20")); // hxg7 a3
+    // Four promotion choices for each of gxh8 and gxf8
+    int promos = 0;
+    for (Move m : g.legal_moves()) promos += m.is_promotion();
+    assert(promos == 8);
+    assert(do_ok(g, "66 77n"));                           // gxh8=N
+    assert(at(g,7,7) == 'N');
+}
+
+static bool same_position(const Game& a, const Game& b) {
+    if (std::memcmp(&a.get_board(), &b.get_board(), sizeof(Board)) != 0) return false;
+    if (a.side_to_move() != b.side_to_move()) return false;
+    if (a.hash() != b.hash()) return false;
+    MoveList la = a.legal_moves(), lb = b.legal_moves();
+    return la.size() == lb.size() && std::equal(la.begin(), la.end(), lb.begin());
+}
+
+void test_make_unmake_roundtrip() {
+    Game g;
+    // A line with a double push, en passant, castling and a capture-promotion
+    const char* line[] = {"14 34", "60 50", "34 44", "63 43", "44 53", "50 40",
+                          "06 25", "40 30", "05 32", "30 20", "04 06", "20 11",
+                          "53 62", "11 00q"};
+    for (const char* mv : line) {
+        Game before = g;
+        for (Move m : g.legal_moves()) {
+            g.make_move(m);
+            g.unmake_move(m);
+            assert(same_position(g, before));
+        }
+        assert(do_ok(g, mv));
+    }
+
+    // perft() against published counts, and it leaves the game as it was.
+    std::string err;
+    Game kiwipete;
+    assert(kiwipete.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", err));
+    Game before = kiwipete;
+    assert(perft(kiwipete, 3) == 97862);
+    assert(same_position(kiwipete, before));
+    Game start;
+    assert(perft(start, 4) == 197281);
+}
+
+void test_zobrist_transpositions() {
+    Game a, b;
+    // 1.Nf3 Nf6 2.Nc3  vs  1.Nc3 Nf6 2.Nf3
+    assert(do_ok(a, "06 25")); assert(do_ok(a, "76 55")); assert(do_ok(a, "01 22"));
+    assert(do_ok(b, "01 22")); assert(do_ok(b, "76 55")); assert(do_ok(b, "06 25"));
+    assert(a.hash() == b.hash());
+
+    // Same placement, different side to move
+    Game c, d;
+    assert(do_ok(c, "06 25")); assert(do_ok(c, "76 55")); assert(do_ok(c, "25 06"));
+    assert(c.hash() != d.hash());
+    assert(do_ok(c, "55 76"));
+    assert(c.hash() == d.hash());
+
+    // A double push with no enemy pawn beside it leaves no EP key behind
+    Game e, f;
+    assert(do_ok(e, "14 34")); assert(do_ok(e, "60 40"));                               // e4 a5
+    assert(do_ok(f, "14 24")); assert(do_ok(f, "60 50")); assert(do_ok(f, "24 34")); assert(do_ok(f, "50 40")); // e3 a6 e4 a5
+    assert(e.hash() == f.hash());
+}
+
+void test_transposition_table() {
+    TranspositionTable tt(1);
+    Move m(to_sq(1,4), to_sq(3,4), Move::DOUBLE_PUSH);
+    std::uint64_t key = 0x1234567890ABCDEFULL;
+
+    TTEntry e;
+    assert(!tt.probe(key, e));
+    tt.store(key, m, -1234, 5, BOUND_LOWER);
+    assert(tt.probe(key, e));
+    assert(e.move == m && e.score == -1234 && e.depth == 5 && e.bound == BOUND_LOWER);
+
+    // Same bucket, different key: must not be mistaken for the stored one
+    assert(!tt.probe(key ^ (1ULL << 63), e));
+
+    // Re-storing without a move keeps the old best move
+    tt.store(key, Move(), 50, 6, BOUND_EXACT);
+    assert(tt.probe(key, e) && e.move == m && e.score == 50 && e.bound == BOUND_EXACT);
+
+    // hashfull samples the first 250 buckets and counts this search's entries
+    tt.clear();
+    assert(!tt.probe(key, e) && tt.hashfull() == 0);
+    for (std::uint64_t k = 0; k < 125; ++k) tt.store(k, m, 0, 1, BOUND_EXACT);
+    assert(tt.hashfull() == 125);
+    tt.new_search();
+    assert(tt.hashfull() == 0);
+}
+
+void test_time_manager_budgets() {
+    TimeManager tm;
+    SearchLimits lim;
+    tm.init(lim, Color::White);
+    assert(!tm.has_budget());                 // depth-only search
+
+    lim.movetime = 500;
+    tm.init(lim, Color::White);
+    assert(tm.soft_ms == tm.hard_ms && tm.hard_ms < 500);
+
+    lim = SearchLimits{};
+    lim.wtime = 60000; lim.btime = 1000; lim.winc = 1000;
+    tm.init(lim, Color::White);
+    assert(tm.soft_ms > 1000 && tm.soft_ms < 60000 / 10);
+    assert(tm.hard_ms >= tm.soft_ms && tm.hard_ms < 60000);
+    tm.init(lim, Color::Black);               // Black's own, much smaller clock
+    assert(tm.hard_ms < 1000);
+}
+
+void test_search_returns_legal_move() {
+    Game g;
+    MinimaxStrategy s;
+    s.limits.depth = 3;
+    int iterations = 0;
+    s.on_iteration = [&](const SearchInfo& info) {
+        ++iterations;
+        assert(!info.pv.empty() && info.hashfull == s.tt.hashfull());
+    };
+    Move m = s.select_move(g);
+    assert(iterations == 3);
+    MoveList lm = g.legal_moves();
+    assert(std::find(lm.begin(), lm.end(), m) != lm.end());
+}
+
+void test_stop_request_ends_search() {
+    Game g;
+    MinimaxStrategy s;
+    s.limits.infinite = true;
+    s.stop_requested = true;                  // a "stop" that arrived before the search began
+    int iterations = 0;
+    s.on_iteration = [&](const SearchInfo&) { ++iterations; };
+    Move m = s.select_move(g);
+    assert(iterations == 1);                  // depth 1 always completes, nothing deeper
+    MoveList lm = g.legal_moves();
+    assert(std::find(lm.begin(), lm.end(), m) != lm.end());
+
+    // While pondering, a spent clock does not end the search.
+    s.stop_requested = false;
+    s.pondering = true;
+    s.timer.hard_ms = 0;
+    assert(!s.should_stop());
+    s.ponderhit();
+    assert(s.should_stop());
+
+    // Pondering past the whole budget, then ponderhit: the budget starts
+    // there, so the search goes on instead of stopping at the next check.
+    // wtime 3000 gives a soft budget of 99 ms and a hard one of 396 ms.
+    MinimaxStrategy p;
+    p.limits.wtime = p.limits.btime = 3000;
+    p.pondering = true;
+    std::thread search([&] { p.select_move(g); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    auto hit = std::chrono::steady_clock::now();
+    p.ponderhit();
+    search.join();
+    auto after = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - hit);
+    assert(after.count() >= 40);               // at least half the soft budget, give or take the clock
+    assert(p.timer.elapsed_ms() >= 500);       // reported time still counts from "go"
+}
+
+void test_lazy_smp_search() {
+    Game g;
+    MinimaxStrategy s;
+    s.threads = 4;
+    s.limits.depth = 4;
+    std::uint64_t reported = 0;
+    s.on_iteration = [&](const SearchInfo& info) { reported = info.nodes; };
+    Move m = s.select_move(g);
+    MoveList lm = g.legal_moves();
+    assert(std::find(lm.begin(), lm.end(), m) != lm.end());
+    assert(s.nodes >= reported && reported > 0); // helpers' nodes are included
+    assert(!s.should_stop());                   // helpers were released and joined
+}
+
+void test_fen_round_trip() {
+    Game start, g;
+    std::string err;
+    assert(g.load_fen(Game::STARTPOS_FEN, err));
+    assert(g.fen() == Game::STARTPOS_FEN);
+    assert(g.hash() == start.hash());
+
+    const char* kiwi = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+    assert(g.load_fen(kiwi, err) && g.fen() == kiwi);
+    assert(g.legal_moves().size() == 48);
+    assert(g.hash() == g.compute_key());
+
+    // EPD form (no counters); the EP square is kept since d5 can take on e6.
+    assert(g.load_fen("4k3/8/8/3Pp3/8/8/8/4K3 w - e6", err));
+    assert(g.fen() == "4k3/8/8/3Pp3/8/8/8/4K3 w - e6 0 1");
+    // ...and dropped when no pawn can, as make_move would; same for a right
+    // whose rook is missing.
+    assert(g.load_fen("4k3/8/8/4p3/8/8/8/R3K3 w KQ e6 3 20", err));
+    assert(g.fen() == "4k3/8/8/4p3/8/8/8/R3K3 w Q - 3 1");
+
+    std::string before = g.fen();
+    assert(!g.load_fen("4k3/8/8/8/8/8/8/8 w - -", err));           // no white king
+    assert(!g.load_fen("4k3/8/8/8/8/8/8/4K3 x - -", err));         // bad side
+    assert(!g.load_fen("4k3/8/8/8/8/8/8/4K2 w - -", err));         // short rank
+    assert(!g.load_fen("4k3/4R3/8/8/8/8/8/4K3 w - -", err));       // black in check, white to move
+    assert(g.fen() == before);                                     // failures leave the game alone
+}
+
+void test_move_ordering() {
+    // pick() hands moves out best score first, each exactly once.
+    ScoredMoveList ml;
+    Game g;
+    g.generate_legal(ml.list);
+    for (int i = 0; i < ml.list.count; ++i) ml.score[i] = (i * 7) % ml.list.count;
+    int last = 1 << 30, seen = 0;
+    while (ml.pick()) {
+        assert(ml.score[ml.picked() - 1] <= last);
+        last = ml.score[ml.picked() - 1];
+        ++seen;
+    }
+    assert(seen == ml.list.count);
+
+    // TT move first, then captures with the most valuable victim.
+    Game k;
+    std::string err;
+    assert(k.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", err));
+    MinimaxStrategy s;
+    auto w = std::make_unique<SearchWorker>();
+    w->pos = k;
+    ScoredMoveList km;
+    k.generate_legal(km.list);
+    Move quiet = k.find_legal_move(to_sq(0,0), to_sq(0,1));   // Ra1-b1
+    s.score_moves(*w, km, quiet, 0);
+    assert(km.pick() == quiet);
+    Move second = km.pick();                                   // Be2xa6: the bishop is the biggest victim
+    assert(second.is_capture() && second.from() == to_sq(1,4) && second.to() == to_sq(5,0));
+
+    s.limits.depth = 4;
+    s.select_move(k);
+    assert(s.fail_high > 0 && s.first_move_cutoff_rate() > 0.5);
+}
+
+void test_see_and_quiescence() {
+    Game g;
+    std::string err;
+    auto see_of = [&](const char* fen, int from, int to) {
+        assert(g.load_fen(fen, err));
+        Move m = g.find_legal_move(from, to);
+        assert(m);
+        return see(g.get_board(), m);
+    };
+    assert(see_of("4k3/8/8/3p4/4P3/8/8/4K3 w - -", to_sq(3,4), to_sq(4,3)) == 100);     // free pawn
+    assert(see_of("4k3/2p5/3p4/8/8/8/3R4/4K3 w - -", to_sq(1,3), to_sq(5,3)) == -400);  // defended
+    assert(see_of("3rk3/8/3p4/8/8/8/3R4/3RK3 w - -", to_sq(1,3), to_sq(5,3)) == 100);   // x-ray backs it
+    assert(see_of("4k3/8/8/3Pp3/8/8/8/4K3 w - e6", to_sq(4,3), to_sq(5,4)) == 100);     // en passant
+
+    // A plain 1-ply search would grab the defended pawn; quiescence sees c7xd6.
+    assert(g.load_fen("4k3/2p5/3p4/8/8/8/3Q4/4K3 w - -", err));
+    MinimaxStrategy s;
+    s.limits.depth = 1;
+    Move m = s.select_move(g);
+    assert(m && !(m.to() == to_sq(5,3) && m.is_capture()));
+    assert(s.qnodes > 0 && s.qnodes <= s.nodes);   // at depth 1 every node is a quiescence node
+}
+
+void test_pvs_search() {
+    // Mate in two: the score counts the plies and the PV plays it out.
+    Game g;
+    std::string err;
+    assert(g.load_fen("7k/8/5K2/8/8/8/8/1R6 w - - 0 1", err));
+    MinimaxStrategy s;
+    int score = 0;
+    s.on_iteration = [&](const SearchInfo& info) { score = info.score; };
+    s.limits.depth = 5;
+    s.select_move(g);
+    assert(score == MinimaxStrategy::MATE - 3);
+    assert(s.root_pv.size() == 3);
+    Game line = g;
+    for (Move m : s.root_pv) {
+        assert(line.find_legal_move(m.from(), m.to()) == m);
+        line.make_move(m);
+    }
+    assert(line.is_checkmate(Color::Black));
+
+    // A full-depth PV from the triangular table, legal move by move.
+    Game k;
+    assert(k.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", err));
+    Move best = s.select_move(k);
+    assert(s.root_pv.size() == 5 && s.root_pv[0] == best);
+    for (Move m : s.root_pv) {
+        assert(k.find_legal_move(m.from(), m.to(), m.is_promotion() ? "nbrq"[m.promotion_type() - KNIGHT] : 0) == m);
+        k.make_move(m);
+    }
+}
+
+void test_selective_search() {
+    // A null move flips the side, drops the EP square and undoes cleanly.
+    Game g;
+    std::string err;
+    assert(g.load_fen("4k3/8/8/3Pp3/8/8/8/4K3 w - e6 0 1", err));
+    std::string before = g.fen();
+    std::uint64_t key = g.hash();
+    g.make_null_move();
+    assert(g.side_to_move() == Color::Black && g.hash() == g.compute_key());
+    assert(g.fen() == "4k3/8/8/3Pp3/8/8/8/4K3 b - - 0 1"); // a pass resets the clock
+    g.unmake_null_move();
+    assert(g.fen() == before && g.hash() == key);
+
+    // Pruning and reductions cut the tree; turning them all off over the
+    // same knobs UCI exposes gives plain PVS back.
+    Game k;
+    assert(k.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", err));
+    MinimaxStrategy sel, full;
+    sel.limits.depth = full.limits.depth = 6;
+    full.params.null_move_depth = full.params.lmr_depth = 64;
+    full.params.rfp_depth = full.params.futility_depth = 0;
+    Move a = sel.select_move(k), b = full.select_move(k);
+    assert(a && b && sel.nodes * 2 < full.nodes);
+}
+
+// The same position with colours swapped and the board flipped.
+static std::string mirrored_fen(const std::string& fen) {
+    std::istringstream ss(fen);
+    std::string placement, side, rights, ep;
+    ss >> placement >> side >> rights >> ep;
+    std::vector<std::string> ranks;
+    std::string rank;
+    for (char c : placement + "/") {
+        if (c == '/') { ranks.insert(ranks.begin(), rank); rank.clear(); continue; }
+        rank += std::isalpha((unsigned char)c) ? char(c ^ 0x20) : c;
+    }
+    std::string out;
+    for (const std::string& r : ranks) out += (out.empty() ? "" : "/") + r;
+    std::string flipped_rights;
+    for (char c : rights) flipped_rights += std::isalpha((unsigned char)c) ? char(c ^ 0x20) : c;
+    std::sort(flipped_rights.begin(), flipped_rights.end());
+    if (ep != "-") ep[1] = char('1' + '8' - ep[1]);
+    return out + (side == "w" ? " b " : " w ") + flipped_rights + " " + ep;
+}
+
+void test_incremental_evaluation() {
+    // Material and PSQ sums follow make/unmake (tests build with
+    // CHESS_HASH_DEBUG, which checks them against a recount every move).
+    Game g;
+    std::string err;
+    assert(g.load_fen("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", err));
+    std::pair<int, int> before{g.psq_midgame(), g.psq_endgame()};
+    assert(before == g.compute_psq());
+    MoveList moves = g.legal_moves();
+    for (Move m : moves) {
+        g.make_move(m);
+        assert(std::make_pair(g.psq_midgame(), g.psq_endgame()) == g.compute_psq());
+        g.unmake_move(m);
+    }
+    assert(std::make_pair(g.psq_midgame(), g.psq_endgame()) == before);
+
+    // Colour symmetry: mirroring a position negates the evaluation.
+    const char* fens[] = {
+        Game::STARTPOS_FEN,
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    };
+    for (const char* f : fens) {
+        Game a, b;
+        assert(a.load_fen(f, err) && b.load_fen(mirrored_fen(f), err));
+        assert(evaluate(a) == -evaluate(b));
+    }
+    Game start;
+    assert(evaluate(start) == TEMPO); // symmetric, so only the side to move counts
+}
+
+void test_draw_detection() {
+    Game g;
+    auto play = [&](int fr, int fc, int tr, int tc) {
+        Move m = g.find_legal_move(to_sq(fr, fc), to_sq(tr, tc));
+        assert(m);
+        g.make_move(m);
+    };
+    auto shuffle = [&] {
+        play(0,6, 2,5); play(7,6, 5,5);   // Ng1-f3 Ng8-f6
+        play(2,5, 0,6); play(5,5, 7,6);   // and back
+    };
+    shuffle();
+    assert(!g.is_repetition());           // twofold: only a draw inside a search
+    assert(g.is_repetition(4));
+    shuffle();
+    assert(g.is_repetition());            // threefold
+
+    // A pawn move is irreversible: nothing before it can repeat.
+    play(1,4, 3,4);
+    assert(!g.is_repetition(100));
+
+    std::string err;
+    assert(g.load_fen("8/8/8/4k3/8/8/8/3QK3 w - - 99 80", err));
+    assert(!g.is_fifty_move_draw());
+    play(0,3, 1,3);                       // Qd1-d2: the hundredth quiet ply
+    assert(g.is_fifty_move_draw());
+
+    // The search sees it too: every move ends the game drawn.
+    assert(g.load_fen("8/8/8/4k3/8/8/8/3QK3 w - - 99 80", err));
+    MinimaxStrategy s;
+    int score = 1;
+    s.on_iteration = [&](const SearchInfo& info) { score = info.score; };
+    s.limits.depth = 3;
+    s.select_move(g);
+    assert(score == 0);
+}
+
+void test_polyglot_book() {
+    auto code = [](int from, int to, int promo = 0) {
+        return std::uint16_t(col_of(to) | row_of(to) << 3 | col_of(from) << 6 | row_of(from) << 9 | promo << 12);
+    };
+    Game start, g;
+    std::string err;
+
+    // Reference keys from the Polyglot format description, move by move
+    // (0: the description gives no key after that move).
+    auto keys_along = [](std::initializer_list<int> squares, std::initializer_list<std::uint64_t> keys) {
+        Game p;
+        auto sq = squares.begin();
+        for (std::uint64_t key : keys) {
+            Move m = p.find_legal_move(sq[0], sq[1]);
+            assert(m);
+            p.make_move(m);
+            assert(!key || polyglot_key(p) == key);
+            sq += 2;
+        }
+    };
+    assert(polyglot_key(start) == 0x463B96181691FC9CULL);
+    keys_along({to_sq(1,4), to_sq(3,4),  to_sq(6,3), to_sq(4,3),  to_sq(3,4), to_sq(4,4),
+                to_sq(6,5), to_sq(4,5),  to_sq(0,4), to_sq(1,4),  to_sq(7,4), to_sq(6,5)},
+               {0x823C9B50FD114196ULL, 0x0756B94461C50FB0ULL, 0x662FAFB965DB29D4ULL,
+                0x22A48B5A8E47FF78ULL, 0x652A607CA3F242C1ULL, 0x00FDD303C946BDD9ULL});
+    keys_along({to_sq(1,0), to_sq(3,0),  to_sq(6,1), to_sq(4,1),  to_sq(1,7), to_sq(3,7),
+                to_sq(4,1), to_sq(3,1),  to_sq(1,2), to_sq(3,2),  to_sq(3,1), to_sq(2,2),
+                to_sq(0,0), to_sq(2,0)},
+               {0, 0, 0, 0, 0x3C8123EA7B067637ULL, 0, 0x5C3F9B829B279560ULL});
+    assert(g.load_fen("rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", err));
+    assert(polyglot_key(g) == 0x3C8123EA7B067637ULL);
+
+    Move e4 = start.find_legal_move(to_sq(1,4), to_sq(3,4));
+    Move d4 = start.find_legal_move(to_sq(1,3), to_sq(3,3));
+    assert(PolyglotBook::decode(start, code(to_sq(1,4), to_sq(3,4))) == e4);
+
+    // Castling is stored as king-takes-rook; promotions by piece number.
+    assert(g.load_fen("r3k2r/8/8/8/8/8/8/R3K2R w KQkq -", err));
+    Move oo = PolyglotBook::decode(g, code(to_sq(0,4), to_sq(0,7)));
+    assert(oo.is_castle() && oo.to() == to_sq(0,6));
+    assert(g.load_fen("8/P6k/8/8/8/8/8/K7 w - -", err));
+    Move n = PolyglotBook::decode(g, code(to_sq(6,0), to_sq(7,0), 1));
+    assert(n.is_promotion() && n.promotion_type() == KNIGHT);
+    assert(!PolyglotBook::decode(g, code(to_sq(6,0), to_sq(7,1))));   // not a legal move
+
+    // A three-position book around the start position's key.
+    std::uint64_t k = polyglot_key(start);
+    auto put = [](std::ofstream& out, std::uint64_t key, std::uint16_t move, std::uint16_t weight) {
+        unsigned char e[16] = {};
+        for (int i = 0; i < 8; ++i) e[i] = (unsigned char)(key >> (56 - 8 * i));
+        e[8] = (unsigned char)(move >> 8);   e[9] = (unsigned char)move;
+        e[10] = (unsigned char)(weight >> 8); e[11] = (unsigned char)weight;
+        out.write(reinterpret_cast<const char*>(e), 16);
+    };
+    std::string path = "test_book.bin";
+    {
+        std::ofstream out(path, std::ios::binary);
+        put(out, k, code(to_sq(1,4), to_sq(3,4)), 3);
+        put(out, k, code(to_sq(1,3), to_sq(3,3)), 1);
+        put(out, k + 1, code(to_sq(1,2), to_sq(3,2)), 5);
+    }
+    PolyglotBook book;
+    assert(!book.open("no_such_book.bin", err));
+    assert(book.open(path, err) && book.size() == 3);
+    assert(book.entries(k).size() == 2 && book.entries(k + 1).size() == 1);
+    assert(book.probe(start, true, 0) == e4);                 // heaviest
+    assert(book.probe(start, false, 2) == e4);                // weights 3:1
+    assert(book.probe(start, false, 3) == d4);
+    book.close();
+    std::remove(path.c_str());
+}
+
+void test_nnue_evaluation() {
+    auto net = std::make_unique<nnue::Network>();
+    net->randomize(12345);
+    std::string err;
+
+    // Save, load back, and reject files that don't fit.
+    assert(net->save("test_net.nnue", err));
+    auto loaded = std::make_unique<nnue::Network>();
+    assert(loaded->load("test_net.nnue", err));
+    assert(std::memcmp(net.get(), loaded.get(), sizeof(nnue::Network)) == 0);
+    std::ofstream("test_net.nnue", std::ios::binary | std::ios::app) << 'x';
+    assert(!loaded->load("test_net.nnue", err) && err.find("size") != std::string::npos);
+    std::remove("test_net.nnue");
+    assert(!loaded->load("test_net.nnue", err));
+
+    // The accumulator follows castling, en passant and promotions, with
+    // every kernel set's update.
+    const char* fens[] = {
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    };
+    const nnue::Kernels* in_use = nnue::kernels;
+    Game g;
+    g.set_network(net.get());
+    for (const nnue::Kernels* k : nnue::supported_kernels()) {
+        nnue::kernels = k;
+        for (const char* f : fens) {
+            assert(g.load_fen(f, err) && g.accumulator_ok());
+            perft(g, 3); // with CHESS_HASH_DEBUG, each make/unmake checks the accumulator
+            assert(g.accumulator_ok());
+        }
+    }
+
+    // Every kernel set gives the same scores, and mirroring a position
+    // negates its (White-positive) score.
+    for (const char* f : fens) {
+        Game a, b;
+        assert(a.load_fen(f, err) && b.load_fen(mirrored_fen(f), err));
+        a.set_network(net.get());
+        b.set_network(net.get());
+        nnue::kernels = &nnue::SCALAR_KERNELS;
+        int reference = nnue_evaluate(a);
+        for (const nnue::Kernels* k : nnue::supported_kernels()) {
+            nnue::kernels = k;
+            assert(nnue_evaluate(a) == reference);
+        }
+        assert(nnue_evaluate(b) == -reference);
+    }
+    nnue::kernels = in_use;
+
+    // The search evaluates with the network when it is given one.
+    MinimaxStrategy s;
+    s.limits.depth = 3;
+    Game start;
+    Move hce = s.select_move(start);
+    s.network = net.get();
+    Move nn = s.select_move(start);
+    assert(hce && nn && !start.network());
+}
+
+void test_batch_evaluation() {
+    const char* fens[] = {
+        Game::STARTPOS_FEN,
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 b - - 7 40",
+    };
+    std::string err;
+    auto net = std::make_unique<nnue::Network>();
+    net->randomize(99);
+
+    // Packing keeps everything the evaluation and a FEN need.
+    std::vector<PackedPosition> packed;
+    std::vector<int> expected, expected_nnue;
+    for (const char* f : fens) {
+        Game g;
+        assert(g.load_fen(f, err));
+        PackedPosition p;
+        assert(p.pack(g));
+        Board b;
+        p.unpack(b);
+        const Board& orig = g.get_board();
+        assert(std::equal(std::begin(b.pieces), std::end(b.pieces), std::begin(orig.pieces)));
+        assert(std::equal(std::begin(b.squares), std::end(b.squares), std::begin(orig.squares)));
+        assert(p.side_to_move() == g.side_to_move() && p.castling == g.castling_rights()
+               && p.ep_sq == g.ep_square() && p.halfmove == g.halfmove_clock());
+        packed.push_back(p);
+        expected.push_back(evaluate(g));
+        g.set_network(net.get());
+        expected_nnue.push_back(nnue_evaluate(g));
+    }
+    Game crowded;
+    assert(crowded.load_fen("QQQQQQQQ/QQQQQQQQ/QQQQQQQQ/8/8/8/pppppppp/k6K w - -", err));
+    PackedPosition p;
+    assert(!p.pack(crowded));
+
+    // Large enough to be split over threads; the result must not depend on how.
+    std::size_t n = packed.size() * 5000;
+    std::vector<PackedPosition> batch;
+    for (std::size_t i = 0; i < n; ++i) batch.push_back(packed[i % packed.size()]);
+    for (int threads : {1, 4}) {
+        std::vector<int> scores(n), nnue_scores(n);
+        evaluate_batch(batch.data(), scores.data(), n, nullptr, threads);
+        evaluate_batch(batch.data(), nnue_scores.data(), n, net.get(), threads);
+        for (std::size_t i = 0; i < n; ++i) {
+            assert(scores[i] == expected[i % packed.size()]);
+            assert(nnue_scores[i] == expected_nnue[i % packed.size()]);
+        }
+    }
+    evaluate_batch(batch.data(), nullptr, 0); // nothing to do
+}
+
+// Reference: the original square-scanning, ray-walking attack detection.
+static bool ray_walk_attacks_square(const Board& b, Color attackerColor, int r, int c) {
+    auto inb = [&](int rr, int cc){ return rr>=0 && rr<ROWS && cc>=0 && cc<COLS; };
+    for (int rr=0; rr<ROWS; ++rr) {
+        for (int cc=0; cc<COLS; ++cc) {
+            int p = b.piece_at(rr, cc);
+            if (p == NO_PIECE || color_of(p) != attackerColor) continue;
+            int dr = std::abs(r-rr), dc = std::abs(c-cc);
+            switch (type_of(p)) {
+                case KNIGHT: if ((dr==2 && dc==1) || (dr==1 && dc==2)) return true; continue;
+                case KING:   if (std::max(dr,dc)==1) return true; continue;
+                case PAWN:   if (r == rr + (attackerColor==Color::White ? 1 : -1) && dc == 1) return true; continue;
+                default: break;
+            }
+            auto ray = [&](int drr, int dcc)->bool {
+                int tr = rr + drr, tc = cc + dcc;
+                while (inb(tr,tc)) {
+                    if (tr == r && tc == c) return true;
+                    if (!b.is_empty(tr,tc)) break;
+                    tr += drr; tc += dcc;
+                }
+                return false;
+            };
+            if (type_of(p)==BISHOP || type_of(p)==QUEEN)
+                if (ray(+1,+1) || ray(+1,-1) || ray(-1,+1) || ray(-1,-1)) return true;
+            if (type_of(p)==ROOK || type_of(p)==QUEEN)
+                if (ray(+1,0) || ray(-1,0) || ray(0,+1) || ray(0,-1)) return true;
+        }
+    }
+    return false;
+}
+
+// Self-check: table lookups must agree with ray walking on random boards.
+void test_attack_tables_match_ray_walk() {
+    std::uint64_t s = 0x2545F4914F6CDD1DULL;
+    auto rnd = [&]() { s ^= s << 13; s ^= s >> 7; s ^= s << 17; return s; };
+
+    for (int n = 0; n < 2000; ++n) {
+        Board b;
+        int count = 2 + int(rnd() % 30);
+        for (int i = 0; i < count; ++i) {
+            int sq = int(rnd() % 64);
+            if (b.squares[sq] == NO_PIECE) b.put_piece(int(rnd() % 12), sq);
+        }
+        for (int sq = 0; sq < 64; ++sq) {
+            int r = row_of(sq), c = col_of(sq);
+            for (Color by : {Color::White, Color::Black})
+                assert(b.attacks_square(by, r, c) == ray_walk_attacks_square(b, by, r, c));
+        }
+    }
+
+    // Every slider square against every blocker pattern along its rays
+    for (int sq = 0; sq < 64; ++sq) {
+        for (int n = 0; n < 200; ++n) {
+            Bitboard occ = rnd() & rnd();
+            assert(rook_attacks(sq, occ)   == sliding_attacks(ROOK_DIRS, sq, occ));
+            assert(bishop_attacks(sq, occ) == sliding_attacks(BISHOP_DIRS, sq, occ));
+        }
+    }
+}
+
 int main() {
     std::cout << "Running tests...\n";
 
@@ -155,6 +846,28 @@ int main() {
     test_kingside_castling_white();
     test_deep_copy_independence();
     test_legal_moves_nonempty_start();
+    test_staged_generation();
+    test_move_encoding();
+    test_underpromotion();
+    test_make_unmake_roundtrip();
+    test_zobrist_transpositions();
+    test_transposition_table();
+    test_time_manager_budgets();
+    test_search_returns_legal_move();
+    test_stop_request_ends_search();
+    test_lazy_smp_search();
+    test_fen_round_trip();
+    test_move_ordering();
+    test_check_evasions_only();
+    test_attack_tables_match_ray_walk();
+    test_see_and_quiescence();
+    test_pvs_search();
+    test_selective_search();
+    test_incremental_evaluation();
+    test_draw_detection();
+    test_polyglot_book();
+    test_nnue_evaluation();
+    test_batch_evaluation();
 
     std::cout << "All tests passed!\n";
     return 0;
@@ -4,6 +4,12 @@
 #include <string>
 #include <vector>
 #include <cctype>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <thread>
 
 #define CHESS_NO_MAIN
 #include "minimax.cpp"   // includes your Game/Board/MinimaxStrategy, etc.
@@ -11,101 +17,324 @@
 // ----- helpers: UCI <-> your engine’s (r,c) format -----
 static inline int file_to_col(char f){ return int(f - 'a'); }          // a..h -> 0..7
 static inline int rank_to_row(char r){ return int(r - '1'); }          // '1'..'8' -> 0..7
-static inline char col_to_file(int c){ return char('a' + c); }
-static inline char row_to_rank(int r){ return char('1' + r); }
 
-static std::string uci_move_to_engine(const std::string& u) {
-    // u like "e2e4" or "e7e8q" (promotion char optional). We ignore the promo letter since engine auto-queens.
-    if (u.size() < 4) return "";
+// "e2e4" / "e7e8q" -> the matching legal Move in 'g', or Move() if there is none.
+static Move uci_move_to_engine(const Game& g, const std::string& u) {
+    if (u.size() < 4) return Move();
     int c0 = file_to_col(u[0]);
     int r0 = rank_to_row(u[1]);
     int c1 = file_to_col(u[2]);
     int r1 = rank_to_row(u[3]);
-    if (r0<0||r0>7||c0<0||c0>7||r1<0||r1>7||c1<0||c1>7) return "";
-    std::string a, b;
-    a.push_back(char('0'+r0)); a.push_back(char('0'+c0));
-    b.push_back(char('0'+r1)); b.push_back(char('0'+c1));
-    return a + " " + b;
+    if (r0<0||r0>7||c0<0||c0>7||r1<0||r1>7||c1<0||c1>7) return Move();
+    char promo = (u.size() > 4) ? u[4] : 'q';
+    return g.find_legal_move(to_sq(r0,c0), to_sq(r1,c1), promo);
 }
 
-static std::string engine_move_to_uci(const std::string& m) {
-    // your moves look like "r0c0 r1c1" but actually "rc rc" with digits, e.g., "14 34"
-    if (m.size() != 5 || m[2] != ' ') return "";
-    int r0 = m[0]-'0', c0 = m[1]-'0', r1 = m[3]-'0', c1 = m[4]-'0';
-    std::string u;
-    u += col_to_file(c0); u += row_to_rank(r0);
-    u += col_to_file(c1); u += row_to_rank(r1);
-    return u; // promotions: engine auto-queens, so no suffix needed
+static std::string engine_move_to_uci(Move m) { return to_uci(m); }
+
+// ----- bench positions -----
+// Fixed set for "bench": openings, middlegames, endgames, plus a few mates
+// and stalemates. Never reorder or edit: the node total is a signature.
+static const char* BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+    "8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+    "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+    "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+    "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+    "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+    "7k/7P/6K1/8/3B4/8/8/8 b - - 0 1",
+    "6k1/5ppp/8/8/8/8/5PPP/3r2K1 w - - 0 1",
+};
+
+// ----- output shared by the input and search threads -----
+static std::mutex out_mutex;
+
+static std::string percent(std::uint64_t part, std::uint64_t whole) {
+    char buf[16];
+    std::snprintf(buf, sizeof buf, "%.1f%%", whole ? 100.0 * part / whole : 0.0);
+    return buf;
+}
+
+static void send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(out_mutex);
+    std::cout << line << "\n";
 }
 
 // ----- simple engine wrapper -----
+// The search runs on 'worker'; the stdin loop only touches 'game' and the
+// options once the worker has been joined (see stop()).
 struct UciEngine {
     Game game;
+    bool game_valid = true;    // false after a "position" that failed to load: "go" refuses
     MinimaxStrategy strat;
-    bool thinking = false;
+    std::thread worker;
+
+    PolyglotBook book;
+    int book_depth = 20;       // plies from the "position" start that may come from the book
+    bool book_best = false;    // heaviest move instead of a weighted draw
+    std::mt19937_64 rng{std::random_device{}()};
+
+    std::unique_ptr<nnue::Network> network; // from EvalFile; null: hand-written evaluation
+
+    ~UciEngine() { stop(); }
+
+    // Ends the running search (if any) and waits for its "bestmove".
+    void stop() {
+        strat.stop_requested = true;
+        if (worker.joinable()) worker.join();
+    }
+
+    void ponderhit() { strat.ponderhit(); }
+
+    // bench [depth] [threads] [hash]: searches BENCH_FENS to a fixed depth
+    // with a cleared table per position. With one thread the node total is
+    // deterministic, so it changes exactly when search behaviour does.
+    void bench(const std::string& cmd) {
+        stop();
+        std::istringstream ss(cmd);
+        std::string tok; ss >> tok;   // "bench"
+        int depth = 5, threads = 1, hash = 16;
+        ss >> depth >> threads >> hash;
+
+        MinimaxStrategy b;             // leaves the game's own settings alone
+        b.threads = std::clamp(threads, 1, 256);
+        b.tt.resize(std::clamp(hash, 1, 65536));
+        b.limits.depth = std::clamp(depth, 1, MinimaxStrategy::MAX_DEPTH);
+
+        std::uint64_t total = 0, qtotal = 0, fail_high = 0, fail_high_first = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        int n = int(std::size(BENCH_FENS));
+        for (int i = 0; i < n; ++i) {
+            Game pos;
+            std::string err;
+            if (!pos.load_fen(BENCH_FENS[i], err)) { send("info string bad bench fen: " + err); continue; }
+            b.tt.clear();
+            b.select_move(pos);
+            total += b.nodes;
+            qtotal += b.qnodes;
+            fail_high += b.fail_high;
+            fail_high_first += b.fail_high_first;
+            send("info string position " + std::to_string(i + 1) + "/" + std::to_string(n)
+                 + " nodes " + std::to_string(b.nodes));
+        }
+        std::int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                              std::chrono::steady_clock::now() - t0).count();
+
+        send("===========================");
+        send("Total time (ms) : " + std::to_string(ms));
+        send("Nodes searched  : " + std::to_string(total));
+        send("Nodes/second    : " + std::to_string(total * 1000 / std::max<std::int64_t>(ms, 1)));
+        send("Quiescence nodes: " + std::to_string(qtotal) + " (" + percent(qtotal, total) + ")");
+        send("First-move cutoffs: " + percent(fail_high_first, fail_high));
+    }
+
+    void new_game() { stop(); game = Game{}; strat.tt.clear(); }
+
+    // setoption name <id> [value <x>]
+    void set_option(const std::string& cmd) {
+        std::istringstream ss(cmd);
+        std::string tok, name, value;
+        ss >> tok >> tok; // "setoption" "name"
+        while (ss >> tok && tok != "value") name += (name.empty() ? "" : " ") + tok;
+        while (ss >> tok) value += (value.empty() ? "" : " ") + tok;
 
-    UciEngine() { strat.max_depth = 3; }
+        stop();
 
-    void new_game() { game = Game{}; }
+        if (name == "Hash") {
+            int mb = 16;
+            try { mb = std::stoi(value); } catch (...) {}
+            strat.tt.resize(std::clamp(mb, 1, 65536));
+        } else if (name == "Threads") {
+            int n = 1;
+            try { n = std::stoi(value); } catch (...) {}
+            strat.threads = std::clamp(n, 1, 256);
+        } else if (name == "BookFile") {
+            book.close();
+            std::string err;
+            if (value.empty() || value == "<empty>") {}
+            else if (!book.open(value, err)) send("info string book not loaded: " + err);
+        } else if (name == "EvalFile") {
+            strat.network = nullptr;
+            network.reset();
+            std::string err;
+            auto net = std::make_unique<nnue::Network>();
+            if (value.empty() || value == "<empty>") {}
+            else if (!net->load(value, err)) send("info string network not loaded: " + err);
+            else {
+                network = std::move(net);
+                strat.network = network.get();
+                send(std::string("info string network loaded, ") + nnue::kernels->name + " kernels");
+            }
+        } else if (name == "BookDepth") {
+            int n = book_depth;
+            try { n = std::stoi(value); } catch (...) {}
+            book_depth = std::clamp(n, 0, 1000);
+        } else if (name == "BookBestMove") {
+            book_best = (value == "true");
+        } else {
+            for (const SearchParamSpec& p : SEARCH_PARAM_SPECS) {
+                if (name != p.name) continue;
+                int v = strat.params.*p.field;
+                try { v = std::stoi(value); } catch (...) {}
+                strat.params.*p.field = std::clamp(v, p.min, p.max);
+            }
+        }
+    }
 
-    // position startpos [moves ...]   (FEN support can be added later)
+    // position startpos [moves ...] | position fen <fen> [moves ...]
     void set_position_from_cmd(const std::string& cmd) {
+        stop();
         std::istringstream ss(cmd);
         std::string tok; ss >> tok;        // "position"
         ss >> tok;                          // "startpos" | "fen"
+        // Until a position loads, 'game' no longer is the one the GUI means.
+        game_valid = false;
         if (tok == "startpos") {
             game = Game{};
-            if (ss >> tok && tok == "moves") {
-                std::string um;
-                while (ss >> um) {
-                    std::string mv = uci_move_to_engine(um);
-                    std::string err;
-                    if (!game.move(mv, err)) {
-                        // ignore bad input from GUI (rare)
-                    }
-                }
-            }
+            ss >> tok;
         } else if (tok == "fen") {
-            // (optional) parse FEN here if you add FEN->Board support
-            // For now, ignore; most GUIs use startpos+moves.
+            std::string fen;
+            while (ss >> tok && tok != "moves") fen += (fen.empty() ? "" : " ") + tok;
+            std::string err;
+            if (!game.load_fen(fen, err)) {
+                send("info string bad fen: " + err);
+                return;
+            }
+        } else {
+            send("info string bad position command");
+            return;
+        }
+        game_valid = true;
+        if (tok == "moves") {
+            std::string um;
+            while (ss >> um) {
+                Move mv = uci_move_to_engine(game, um);
+                if (mv) game.make_move(mv); // ignore bad input from GUI (rare)
+            }
         }
     }
 
-    // go depth N | go movetime T(ms)
-    void go(const std::string& cmd) {
-        thinking = true;
+    UciEngine() {
+        strat.max_depth = 3;
+        strat.on_iteration = [](const SearchInfo& info) {
+            std::int64_t nps = info.time_ms > 0 ? std::int64_t(info.nodes * 1000 / info.time_ms) : 0;
+            std::ostringstream os;
+            os << "info depth " << info.depth;
+            if (MinimaxStrategy::is_mate_score(info.score)) {
+                int plies = MinimaxStrategy::MATE - std::abs(info.score);
+                os << " score mate " << (info.score > 0 ? (plies + 1) / 2 : -(plies / 2));
+            } else {
+                os << " score cp " << info.score;
+            }
+            os << " nodes " << info.nodes
+               << " nps " << nps
+               << " hashfull " << info.hashfull
+               << " time " << info.time_ms
+               << " pv";
+            for (Move m : info.pv) os << " " << engine_move_to_uci(m);
+            send(os.str());
+            // Not a standard "info" field, so it goes out as a string.
+            send("info string qnodes " + std::to_string(info.qnodes)
+                 + " (" + percent(info.qnodes, info.nodes) + " of nodes)");
+        };
+    }
 
-        int depth = strat.max_depth;        // default
-        int movetime_ms = -1;
+    // go [depth N] [movetime T] [wtime W btime B [winc I binc J] [movestogo M]] [infinite] [ponder]
+    void go(const std::string& cmd) {
+        stop();
+        if (!game_valid) {
+            send("info string no valid position; send \"position\" again");
+            send("bestmove 0000");
+            return;
+        }
 
-        // parse args
+        SearchLimits lim;
         {
             std::istringstream ss(cmd);
             std::string tok; ss >> tok; // "go"
             while (ss >> tok) {
-                if (tok == "depth") { ss >> depth; }
-                else if (tok == "movetime") { ss >> movetime_ms; }
-                // (You can parse wtime/btime/inc for time mgmt later)
+                if      (tok == "depth")     ss >> lim.depth;
+                else if (tok == "movetime")  ss >> lim.movetime;
+                else if (tok == "wtime")     ss >> lim.wtime;
+                else if (tok == "btime")     ss >> lim.btime;
+                else if (tok == "winc")      ss >> lim.winc;
+                else if (tok == "binc")      ss >> lim.binc;
+                else if (tok == "movestogo") ss >> lim.movestogo;
+                else if (tok == "infinite")  lim.infinite = true;
+                else if (tok == "ponder")    lim.ponder = true;
+            }
+        }
+        // A book reply goes out at once, unless the GUI wants a search that
+        // runs until "stop".
+        if (!lim.infinite && !lim.ponder && game.plies_played() < book_depth) {
+            if (Move m = book.probe(game, book_best, rng())) {
+                send("info string book move");
+                send("bestmove " + engine_move_to_uci(m));
+                return;
             }
         }
 
-        // set depth (we ignore movetime for now; add time cutoff later)
-        strat.max_depth = std::max(1, depth);
+        strat.limits = lim;
+        strat.pondering = lim.ponder;
+        strat.stop_requested = false;
 
-        // search
-        std::string best = strat.select_move(game);
+        worker = std::thread([this] {
+            Move best = strat.select_move(game);
 
-        if (best.empty()) {
-            std::cout << "bestmove 0000\n";
-        } else {
-            std::cout << "bestmove " << engine_move_to_uci(best) << "\n";
-        }
-        std::cout.flush();
-        thinking = false;
+            // "bestmove" must not come before "stop" (infinite) or before
+            // "ponderhit"/"stop" (ponder), even if the search ended early.
+            while (!strat.stop_requested &&
+                   (strat.limits.infinite || strat.pondering))
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+            send("info string first-move cutoffs " + percent(strat.fail_high_first, strat.fail_high));
+            if (!best) { send("bestmove 0000"); return; }
+            std::string out = "bestmove " + engine_move_to_uci(best);
+            if (strat.root_pv.size() > 1) out += " ponder " + engine_move_to_uci(strat.root_pv[1]);
+            send(out);
+        });
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
     std::ios::sync_with_stdio(false);
     std::cin.tie(nullptr);
     std::cout.setf(std::ios::unitbuf); // auto-flush
@@ -113,15 +342,34 @@ int main() {
     UciEngine E;
     std::string line;
 
+    // "myengine bench [depth] [threads] [hash]" runs the bench and exits.
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        for (int i = 1; i < argc; ++i) line += (i > 1 ? " " : "") + std::string(argv[i]);
+        E.bench(line);
+        return 0;
+    }
+
     while (std::getline(std::cin, line)) {
         if (line == "uci") {
-            std::cout << "id name MyEngine\n";
-            std::cout << "id author You\n";
-            std::cout << "uciok\n";
+            send("id name MyEngine");
+            send("id author You");
+            send("option name Hash type spin default 16 min 1 max 65536");
+            send("option name Threads type spin default 1 min 1 max 256");
+            send("option name Ponder type check default false");
+            send("option name BookFile type string default <empty>");
+            send("option name BookDepth type spin default 20 min 0 max 1000");
+            send("option name BookBestMove type check default false");
+            send("option name EvalFile type string default <empty>");
+            const SearchParams defaults;
+            for (const SearchParamSpec& p : SEARCH_PARAM_SPECS)
+                send(std::string("option name ") + p.name + " type spin default "
+                     + std::to_string(defaults.*p.field) + " min " + std::to_string(p.min)
+                     + " max " + std::to_string(p.max));
+            send("uciok");
         } else if (line == "isready") {
-            std::cout << "readyok\n";
+            send("readyok"); // answered at once, even mid-search
         } else if (line.rfind("setoption", 0) == 0) {
-            // ignore for now or parse options
+            E.set_option(line);
         } else if (line == "ucinewgame") {
             E.new_game();
         } else if (line.rfind("position", 0) == 0) {
@@ -129,8 +377,13 @@ int main() {
         } else if (line.rfind("go", 0) == 0) {
             E.go(line);
         } else if (line == "stop") {
-            // No async search here; nothing to cancel.
+            E.stop();
+        } else if (line == "ponderhit") {
+            E.ponderhit();
+        } else if (line.rfind("bench", 0) == 0) {
+            E.bench(line);
         } else if (line == "quit") {
+            E.stop();
             break;
         }
     }